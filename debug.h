@@ -3,7 +3,7 @@
  *
  * Written by Hampus Fridholm
  *
- * Last updated: 2024-12-04
+ * Last updated: 2026-10-18
  *
  *
  * In main compilation unit; define DEBUG_IMPLEMENT
@@ -21,8 +21,23 @@
  *
  * void debug_file_close(void)
  *
+ * int trace_file_open(const char* filepath)
  *
- * Uses va_list for argument parsing, like in getstr.c
+ * void trace_file_close(void)
+ *
+ * trace_begin(name, arg), trace_end(name, arg)
+ *
+ * trace_async_begin(name, id, arg), trace_async_end(name, id, arg)
+ *
+ *
+ * When a debug file is open, error_print and info_print only put the
+ * message in a ring buffer, which a background thread writes to the file
+ *
+ * The trace is a binary ring of timestamped events in a memory-mapped file,
+ * which trace.c converts to Chrome trace-event JSON
+ *
+ * Messages and events below DEBUG_LEVEL are compiled out, for example:
+ * #define DEBUG_LEVEL DEBUG_LEVEL_ERROR
  */
 
 /*
@@ -34,6 +49,49 @@
 #define DEBUG_H
 
 #include <stdio.h>
+#include <stdint.h>
+
+#define DEBUG_LEVEL_NONE  0
+#define DEBUG_LEVEL_ERROR 1
+#define DEBUG_LEVEL_INFO  2
+#define DEBUG_LEVEL_TRACE 3
+
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL DEBUG_LEVEL_TRACE
+#endif
+
+#define TRACE_MAGIC   "STKTRACE"
+#define TRACE_VERSION 1
+
+/*
+ * Header of trace file, followed by capacity records
+ *
+ * count is the number of written records, so the
+ * latest record is at (count - 1) % capacity
+ */
+typedef struct trace_header_t
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;
+  uint64_t count;
+} trace_header_t;
+
+/*
+ * Trace event record
+ *
+ * phase is a Chrome trace-event phase:
+ * 'B' and 'E' for begin and end, 'b' and 'e' for async begin and end
+ */
+typedef struct trace_record_t
+{
+  uint64_t time; // Nanoseconds, monotonic clock
+  uint64_t id;   // Id of async event
+  char     phase;
+  char     name[15];
+  char     arg[16];
+} trace_record_t;
 
 extern int debug_print(FILE* stream, const char* title, const char* format, ...);
 
@@ -48,6 +106,36 @@ extern void debug_file_close(void);
 
 extern FILE* debug_file;
 
+
+extern int  trace_file_open(const char* filepath);
+
+extern void trace_file_close(void);
+
+extern void trace_event(char phase, const char* name, uint64_t id, const char* arg);
+
+/*
+ * The arguments of compiled out messages are not evaluated
+ */
+#if DEBUG_LEVEL < DEBUG_LEVEL_ERROR
+#define error_print(...) ((void) 0)
+#endif
+
+#if DEBUG_LEVEL < DEBUG_LEVEL_INFO
+#define info_print(...) ((void) 0)
+#endif
+
+#if DEBUG_LEVEL < DEBUG_LEVEL_TRACE
+#define trace_begin(name, arg)           ((void) 0)
+#define trace_end(name, arg)             ((void) 0)
+#define trace_async_begin(name, id, arg) ((void) 0)
+#define trace_async_end(name, id, arg)   ((void) 0)
+#else
+#define trace_begin(name, arg)           trace_event('B', name, 0, arg)
+#define trace_end(name, arg)             trace_event('E', name, 0, arg)
+#define trace_async_begin(name, id, arg) trace_event('b', name, (uint64_t) (uintptr_t) (id), arg)
+#define trace_async_end(name, id, arg)   trace_event('e', name, (uint64_t) (uintptr_t) (id), arg)
+#endif
+
 #endif // DEBUG_H
 
 /*
@@ -60,9 +148,15 @@ extern FILE* debug_file;
 
 #include <stdarg.h>
 #include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
 
-#include <sys/time.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 FILE* debug_file = NULL;
 
@@ -76,164 +170,275 @@ FILE* debug_file = NULL;
 #define DEBUG_FORMAT "[%s] [ %s ]: %s\n"
 
 /*
- * Format string of current time
+ * Number of messages in the ring (power of two),
+ * and the size of each message, longer messages are cut
+ */
+#define DEBUG_RING_SIZE    1024
+#define DEBUG_MESSAGE_SIZE 256
+
+/*
+ * Milliseconds between the flushes of the ring to the debug file
+ */
+#define DEBUG_FLUSH_INTERVAL 100
+
+/*
+ * Message in the ring
+ *
+ * sequence tells if the entry is free to write or ready to read
+ */
+typedef struct dbg_entry_t
+{
+  atomic_size_t   sequence;
+  struct timespec time;
+  const char*     title;
+  char            message[DEBUG_MESSAGE_SIZE];
+} dbg_entry_t;
+
+static dbg_entry_t   dbg_ring[DEBUG_RING_SIZE];
+static atomic_size_t dbg_ring_head = 0; // Next entry to write, shared by every writer
+static size_t        dbg_ring_tail = 0; // Next entry to read, only used by the flusher
+static atomic_size_t dbg_dropped   = 0; // Messages dropped because the ring was full
+
+static pthread_t     dbg_flusher;
+static bool          dbg_is_flushing = false;
+static atomic_bool   dbg_is_stopping = false;
+
+/*
+ * Format string of time
  *
  * PARAMS
- * - char* buffer | Buffer to store time string
+ * - char* buffer         | Buffer to store time string
+ * - struct timespec time | Time of the message
  *
  * RETURN (char* buffer)
- * - NULL | Failed to get time of day
  */
-static inline char* dbg_timestr_create(char* buffer)
+static inline char* dbg_timestr_create(char* buffer, struct timespec time)
 {
-  struct timeval timeval;
-  if(gettimeofday(&timeval, NULL) == -1) return NULL;
+  struct tm timeinfo;
 
-  struct tm* timeinfo = localtime(&timeval.tv_sec);
+  localtime_r(&time.tv_sec, &timeinfo);
 
-  strftime(buffer, 10, "%H:%M:%S", timeinfo);
+  strftime(buffer, 10, "%H:%M:%S", &timeinfo);
 
-  sprintf(buffer + 8, ".%02ld", timeval.tv_usec / 10000);
+  sprintf(buffer + 8, ".%02ld", time.tv_nsec / 10000000);
 
   return buffer;
 }
 
 /*
- * Parse va_list argument and print it to a buffer
- *
- * PARAMS
- * - char* buffer          | Buffer to store printed argument
- * - const char* specifier | Argument format specifier
- * - va_list args          | va_list argument list
+ * Print custom debug message, taking in va_list
  *
- * RETURN (int amount, same as sprintf)
+ * RETURN (same as fprintf)
  * - >=0 | Number of printed characters
- * -  -1 | Format specifier does not exist, or sprintf error
+ * -  -1 | Format error
  */
-static inline int dbg_specifier_append(char* buffer, const char* specifier, va_list args)
+static inline int dbg_valist_print(FILE* stream, const char* title, const char* format, va_list args)
 {
-  if(strncmp(specifier, "d", 1) == 0)
-  {
-    int arg = va_arg(args, int);
+  struct timespec time;
 
-    return sprintf(buffer, "%d", arg);
-  }
-  else if(strncmp(specifier, "ld", 2) == 0)
-  {
-    long int arg = va_arg(args, long int);
+  clock_gettime(CLOCK_REALTIME, &time);
 
-    return sprintf(buffer, "%ld", arg);
-  }
-  else if(strncmp(specifier, "lld", 2) == 0)
-  {
-    long long int arg = va_arg(args, long long int);
+  char timestr[32];
+
+  dbg_timestr_create(timestr, time);
+
+  char string[1024];
 
-    return sprintf(buffer, "%lld", arg);
+  if(vsnprintf(string, sizeof(string), format, args) < 0)
+  {
+    return -1;
   }
-  else if(strncmp(specifier, "c", 1) == 0)
+
+  return fprintf(stream, DEBUG_FORMAT, timestr, title, string);
+}
+
+/*
+ * Put message in the ring, without waiting for the debug file
+ *
+ * The ring is a bounded queue, where every entry has a sequence number,
+ * so that writers claim entries with compare-and-swap instead of a lock
+ *
+ * RETURN (same as sprintf)
+ * - >=0 | Number of characters in message
+ * -  -1 | Format error, or the ring is full and the message is dropped
+ */
+static inline int dbg_ring_valist_put(const char* title, const char* format, va_list args)
+{
+  size_t position = atomic_load_explicit(&dbg_ring_head, memory_order_relaxed);
+
+  dbg_entry_t* entry;
+
+  for(;;)
   {
-    // ‘char’ is promoted to ‘int’ when passed through ‘...’
-    int arg = va_arg(args, int);
+    entry = &dbg_ring[position & (DEBUG_RING_SIZE - 1)];
+
+    size_t sequence = atomic_load_explicit(&entry->sequence, memory_order_acquire);
 
-    return sprintf(buffer, "%c", arg);
+    intptr_t diff = (intptr_t) sequence - (intptr_t) position;
+
+    if(diff == 0)
+    {
+      if(atomic_compare_exchange_weak_explicit(&dbg_ring_head, &position, position + 1, memory_order_relaxed, memory_order_relaxed)) break;
+    }
+    else if(diff < 0)
+    {
+      atomic_fetch_add_explicit(&dbg_dropped, 1, memory_order_relaxed);
+
+      return -1;
+    }
+    else position = atomic_load_explicit(&dbg_ring_head, memory_order_relaxed);
   }
-  else if(strncmp(specifier, "f", 1) == 0)
+
+  clock_gettime(CLOCK_REALTIME, &entry->time);
+
+  entry->title = title;
+
+  int amount = vsnprintf(entry->message, DEBUG_MESSAGE_SIZE, format, args);
+
+  if(amount < 0) strcpy(entry->message, format);
+
+  atomic_store_explicit(&entry->sequence, position + 1, memory_order_release);
+
+  return amount;
+}
+
+/*
+ * Write the messages in the ring to the debug file
+ *
+ * Only called by one thread at a time, the flusher
+ * or the thread that stops the flusher
+ */
+static inline void dbg_ring_flush(void)
+{
+  bool is_written = false;
+
+  for(;;)
   {
-    // ‘float’ is promoted to ‘double’ when passed through ‘...’
-    double arg = va_arg(args, double);
+    dbg_entry_t* entry = &dbg_ring[dbg_ring_tail & (DEBUG_RING_SIZE - 1)];
+
+    size_t sequence = atomic_load_explicit(&entry->sequence, memory_order_acquire);
+
+    if(sequence != dbg_ring_tail + 1) break;
 
-    return sprintf(buffer, "%lf", arg);
+    char timestr[32];
+
+    dbg_timestr_create(timestr, entry->time);
+
+    fprintf(debug_file, DEBUG_FORMAT, timestr, entry->title, entry->message);
+
+    atomic_store_explicit(&entry->sequence, dbg_ring_tail + DEBUG_RING_SIZE, memory_order_release);
+
+    dbg_ring_tail++;
+
+    is_written = true;
   }
-  else if(strncmp(specifier, "s", 1) == 0)
+
+  size_t dropped = atomic_exchange_explicit(&dbg_dropped, 0, memory_order_relaxed);
+
+  if(dropped > 0)
   {
-    const char* arg = va_arg(args, const char*);
+    struct timespec time;
+
+    clock_gettime(CLOCK_REALTIME, &time);
 
-    return sprintf(buffer, "%s", arg);
+    char timestr[32];
+
+    dbg_timestr_create(timestr, time);
+
+    fprintf(debug_file, "[%s] [ WARNING ]: %zu messages dropped\n", timestr, dropped);
+
+    is_written = true;
   }
-  else return -1; // Specifier does not exist
+
+  if(is_written) fflush(debug_file);
 }
 
 /*
- * Formats just a single format specifier argument from va_list
- *
- * RETURN (int amount, same as sprintf)
- * - >=0 | Number of printed characters
- * -  -1 | Format specifier does not exist, or sprintf error
+ * Background thread, flushing the ring until it is stopped
  */
-static inline int dbg_arg_append(char* buffer, const char* format, int f_length, int* f_index, va_list args)
+static void* dbg_flusher_run(void* arg)
 {
-  char specifier[f_length + 1];
-
-  for(int s_index = 0; (*f_index)++ < f_length; s_index++)
+  struct timespec interval =
   {
-    specifier[s_index] = format[*f_index];
-    specifier[s_index + 1] = '\0';
+    .tv_sec  = DEBUG_FLUSH_INTERVAL / 1000,
+    .tv_nsec = (DEBUG_FLUSH_INTERVAL % 1000) * 1000000
+  };
 
-    int amount = dbg_specifier_append(buffer, specifier, args);
+  while(!atomic_load(&dbg_is_stopping))
+  {
+    dbg_ring_flush();
 
-    // If a valid format specifier has been found and parsed,
-    // return the status of the appended specifier
-    if(amount > 0) return amount;
+    nanosleep(&interval, NULL);
   }
 
-  return -1;
+  return NULL;
 }
 
 /*
- * sprintf, but with va_list as arguments
+ * Start the flusher thread of the ring
  *
- * RETURN (same as sprintf)
- * - >=0 | Number of printed characters
- * -  -1 | Format specifier does not exist, or sprintf error
+ * RETURN (int status)
+ * - 0 | Success
+ * - 1 | Failed to create thread
  */
-static inline int dbg_string_create(char* string, const char* format, va_list args)
+static inline int dbg_flusher_start(void)
 {
-  const size_t f_length = strlen(format);
+  atomic_store(&dbg_is_stopping, false);
 
-  int s_index = 0;
+  if(pthread_create(&dbg_flusher, NULL, &dbg_flusher_run, NULL) != 0) return 1;
 
-  for(int f_index = 0; f_index < f_length; f_index++)
-  {
-    if(format[f_index] == '%')
-    {
-      int amount = dbg_arg_append(string + s_index, format, f_length, &f_index, args);
+  dbg_is_flushing = true;
 
-      if(amount < 0) return -1;
+  return 0;
+}
 
-      s_index += amount;
-    }
-    else string[s_index++] = format[f_index];
-  }
+/*
+ * Stop the flusher thread, and write the remaining messages
+ */
+static inline void dbg_flusher_stop(void)
+{
+  if(!dbg_is_flushing) return;
+
+  atomic_store(&dbg_is_stopping, true);
 
-  string[s_index] = '\0';
+  pthread_join(dbg_flusher, NULL);
 
-  return s_index;
+  dbg_is_flushing = false;
+
+  dbg_ring_flush();
 }
 
 /*
- * Print custom debug message, taking in va_list
+ * Print message to debug file through the ring,
+ * or directly to stream if there is no debug file
  *
- * RETURN (same as fprintf)
- * - >=0 | Number of printed characters
- * -  -1 | Format specifier does not exist, or sprintf error
+ * RETURN (same as sprintf)
+ * - >=0 | Number of characters in message
+ * -  -1 | Format error, or the message is dropped
  */
-static inline int dbg_valist_print(FILE* stream, const char* title, const char* format, va_list args)
+static inline int dbg_message_print(FILE* stream, const char* title, const char* stream_title, const char* format, va_list args)
 {
-  char timestr[32];
-
-  if(dbg_timestr_create(timestr) == NULL)
+  if(debug_file && dbg_is_flushing)
   {
-    return -1;
+    return dbg_ring_valist_put(title, format, args);
   }
 
-  char string[1024];
+  int amount;
 
-  if(dbg_string_create(string, format, args) < 0)
+  if(debug_file)
   {
-    return -1;
+    amount = dbg_valist_print(debug_file, title, format, args);
+
+    fflush(debug_file);
   }
+  else
+  {
+    amount = dbg_valist_print(stream, stream_title, format, args);
 
-  return fprintf(stream, DEBUG_FORMAT, timestr, title, string);
+    fflush(stream);
+  }
+
+  return amount;
 }
 
 /*
@@ -241,7 +446,7 @@ static inline int dbg_valist_print(FILE* stream, const char* title, const char*
  *
  * RETURN (same as fprintf)
  * - >=0 | Number of printed characters
- * -  -1 | Format specifier does not exist, or sprintf error
+ * -  -1 | Format error
  */
 int debug_print(FILE* stream, const char* title, const char* format, ...)
 {
@@ -259,32 +464,22 @@ int debug_print(FILE* stream, const char* title, const char* format, ...)
 }
 
 /*
- * Print debug error message to stderr
+ * Print debug error message to debug file or stderr
  *
- * RETURN (same as fprintf)
- * - >=0 | Number of printed characters
- * -  -1 | Format specifier does not exist, or sprintf error
+ * The name is in parentheses, so that it isn't replaced
+ * by the macro when error messages are compiled out
+ *
+ * RETURN (same as sprintf)
+ * - >=0 | Number of characters in message
+ * -  -1 | Format error, or the message is dropped
  */
-int error_print(const char* format, ...)
+int (error_print)(const char* format, ...)
 {
   va_list args;
 
   va_start(args, format);
 
-  int amount;
-
-  if(debug_file)
-  {
-    amount = dbg_valist_print(debug_file, "ERROR", format, args);
-
-    fflush(debug_file);
-  }
-  else
-  {
-    amount = dbg_valist_print(stderr, "\e[1;37mERROR\e[0m", format, args);
-
-    fflush(stderr);
-  }
+  int amount = dbg_message_print(stderr, "ERROR", "\e[1;37mERROR\e[0m", format, args);
 
   va_end(args);
 
@@ -292,32 +487,19 @@ int error_print(const char* format, ...)
 }
 
 /*
- * Print debug info message to stdout
+ * Print debug info message to debug file or stdout
  *
- * RETURN (same as fprintf)
- * - >=0 | Number of printed characters
- * -  -1 | Format specifier does not exist, or sprintf error
+ * RETURN (same as sprintf)
+ * - >=0 | Number of characters in message
+ * -  -1 | Format error, or the message is dropped
  */
-int info_print(const char* format, ...)
+int (info_print)(const char* format, ...)
 {
   va_list args;
 
   va_start(args, format);
 
-  int amount;
-
-  if(debug_file)
-  {
-    amount = dbg_valist_print(debug_file, "INFO", format, args);
-
-    fflush(debug_file);
-  }
-  else
-  {
-    amount = dbg_valist_print(stdout, "\e[1;37mINFO \e[0m", format, args);
-
-    fflush(stdout);
-  }
+  int amount = dbg_message_print(stdout, "INFO", "\e[1;37mINFO \e[0m", format, args);
 
   va_end(args);
 
@@ -327,6 +509,9 @@ int info_print(const char* format, ...)
 /*
  * Open and start printing to debug file
  *
+ * If the flusher thread can't be started,
+ * messages are written directly to the file
+ *
  * RETURN (int status)
  * - 0 | Success
  * - 1 | Failed to open file
@@ -337,27 +522,155 @@ int debug_file_open(const char* filepath)
 
   if(!stream) return 1;
 
-  if(debug_file) fclose(debug_file);
+  if(debug_file)
+  {
+    dbg_flusher_stop();
+
+    fclose(debug_file);
+  }
+  else
+  {
+    // The ring is empty, because it is flushed when the file is closed
+    for(size_t index = 0; index < DEBUG_RING_SIZE; index++)
+    {
+      atomic_init(&dbg_ring[index].sequence, index);
+    }
+
+    atomic_store(&dbg_ring_head, 0);
+
+    dbg_ring_tail = 0;
+  }
 
   debug_file = stream;
 
+  dbg_flusher_start();
+
   return 0;
 }
 
 /*
- * Close the debug file
+ * Write the remaining messages and close the debug file
  */
 void debug_file_close(void)
 {
+  dbg_flusher_stop();
+
   if(debug_file) fclose(debug_file);
 
   debug_file = NULL;
 }
 
+/*
+ * Number of records in the trace ring
+ */
+#define TRACE_CAPACITY 65536
+
+static trace_header_t* trace_header  = NULL;
+static trace_record_t* trace_records = NULL;
+static size_t          trace_size    = 0;
+
+/*
+ * Open trace file, mapping it to memory
+ *
+ * The file is truncated and has a fixed size,
+ * where the oldest records are overwritten
+ *
+ * RETURN (int status)
+ * - 0 | Success
+ * - 1 | Failed to open file
+ * - 2 | Failed to resize file
+ * - 3 | Failed to map file
+ */
+int trace_file_open(const char* filepath)
+{
+  trace_file_close();
+
+  int fd = open(filepath, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+  if(fd == -1) return 1;
+
+  size_t size = sizeof(trace_header_t) + sizeof(trace_record_t) * TRACE_CAPACITY;
+
+  if(ftruncate(fd, size) != 0)
+  {
+    close(fd);
+
+    return 2;
+  }
+
+  void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+  // The mapping is kept after the file is closed
+  close(fd);
+
+  if(memory == MAP_FAILED) return 3;
+
+  trace_header = memory;
+
+  *trace_header = (trace_header_t)
+  {
+    .version     = TRACE_VERSION,
+    .record_size = sizeof(trace_record_t),
+    .capacity    = TRACE_CAPACITY,
+    .count       = 0
+  };
+
+  memcpy(trace_header->magic, TRACE_MAGIC, sizeof(trace_header->magic));
+
+  trace_records = (trace_record_t*) (trace_header + 1);
+
+  trace_size = size;
+
+  return 0;
+}
+
+/*
+ * Unmap and close the trace file
+ */
+void trace_file_close(void)
+{
+  if(!trace_header) return;
+
+  munmap(trace_header, trace_size);
+
+  trace_header  = NULL;
+  trace_records = NULL;
+  trace_size    = 0;
+}
+
+/*
+ * Write trace event to the ring, if the trace file is open
+ *
+ * Use the trace_ macros, which can be compiled out
+ */
+void trace_event(char phase, const char* name, uint64_t id, const char* arg)
+{
+  if(!trace_header) return;
+
+  uint64_t index = __atomic_fetch_add(&trace_header->count, 1, __ATOMIC_RELAXED);
+
+  trace_record_t* record = &trace_records[index % TRACE_CAPACITY];
+
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  record->time  = (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+  record->id    = id;
+  record->phase = phase;
+
+  strncpy(record->name, name, sizeof(record->name) - 1);
+
+  record->name[sizeof(record->name) - 1] = '\0';
+
+  strncpy(record->arg, arg ? arg : "", sizeof(record->arg) - 1);
+
+  record->arg[sizeof(record->arg) - 1] = '\0';
+}
+
 #endif // DEBUG_IMPLEMENT
 
 /*
  * Maybe:
- * - Add pthread mutex locks to make global "file" thread safe
  * - Create multiple debug files for [stderr, stdout]
  */
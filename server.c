@@ -0,0 +1,654 @@
+/*
+ * server.c - local stand-in for the chart API of Yahoo Finance
+ *
+ * Written by Hampus Fridholm
+ *
+ * Usage: server [port] [points] [latency]
+ *
+ * Every GET /v8/finance/chart/<symbol>?range=<range>&interval=<interval>
+ * is answered with made up prices. The prices are the same every time for
+ * the same symbol, range and interval.
+ *
+ * points  - number of prices in every response (default 100)
+ * latency - milliseconds before every response is sent (default 0)
+ *
+ * Start stocks against the server with: ./stocks --url http://127.0.0.1:8080
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#define SERVER_PORT    8080
+#define SERVER_POINTS  100
+#define SERVER_LATENCY 0
+
+#define SERVER_REQUEST_SIZE 4096
+
+#define SERVER_PATH "/v8/finance/chart/"
+
+#define MIN(a, b) (((a) > (b)) ? (b) : (a))
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+
+/*
+ * Growing string, for building responses
+ */
+typedef struct buffer_t
+{
+  char*  string;
+  size_t length;
+  size_t size;
+} buffer_t;
+
+/*
+ * Connection to a client
+ *
+ * The response is sent when the time is past due,
+ * and the connection is kept open for the next request
+ */
+typedef struct client_t
+{
+  int      socket;
+  char     request[SERVER_REQUEST_SIZE];
+  size_t   request_len;
+  buffer_t response;
+  size_t   response_sent;
+  bool     is_waiting;
+  bool     is_sending;
+  long     due;
+} client_t;
+
+static int server_points  = SERVER_POINTS;
+static int server_latency = SERVER_LATENCY;
+
+static client_t** clients      = NULL;
+static size_t     client_count = 0;
+
+/*
+ * Get time in milliseconds
+ */
+static long server_time_get(void)
+{
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return time.tv_sec * 1000 + time.tv_nsec / 1000000;
+}
+
+/*
+ * Append formatted string to buffer
+ */
+static int buffer_printf(buffer_t* buffer, const char* format, ...)
+{
+  va_list args;
+
+  va_start(args, format);
+
+  int length = vsnprintf(NULL, 0, format, args);
+
+  va_end(args);
+
+  if (length < 0)
+  {
+    return 1;
+  }
+
+  if (buffer->length + length + 1 > buffer->size)
+  {
+    size_t size = MAX(buffer->size * 2, buffer->length + length + 1);
+
+    char* string = realloc(buffer->string, sizeof(char) * size);
+
+    if (!string)
+    {
+      return 2;
+    }
+
+    buffer->string = string;
+
+    buffer->size = size;
+  }
+
+  va_start(args, format);
+
+  vsnprintf(buffer->string + buffer->length, length + 1, format, args);
+
+  va_end(args);
+
+  buffer->length += length;
+
+  return 0;
+}
+
+/*
+ * Get seconds between prices of interval
+ */
+static long interval_seconds_get(const char* interval)
+{
+  if (strcmp(interval, "1m")  == 0) return 60;
+  if (strcmp(interval, "15m") == 0) return 900;
+  if (strcmp(interval, "30m") == 0) return 1800;
+  if (strcmp(interval, "1h")  == 0) return 3600;
+  if (strcmp(interval, "1wk") == 0) return 604800;
+  if (strcmp(interval, "1mo") == 0) return 2592000;
+
+  return 86400;
+}
+
+/*
+ * Get the value of a parameter in the query of the request
+ */
+static void query_value_get(char* buffer, size_t size, const char* query, const char* name)
+{
+  buffer[0] = '\0';
+
+  size_t name_len = strlen(name);
+
+  for (const char* param = query; param && *param; )
+  {
+    if (strncmp(param, name, name_len) == 0 && param[name_len] == '=')
+    {
+      const char* value = param + name_len + 1;
+
+      size_t length = strcspn(value, "& ");
+
+      snprintf(buffer, size, "%.*s", (int) MIN(length, size - 1), value);
+
+      return;
+    }
+
+    param = strchr(param, '&');
+
+    if (param) param++;
+  }
+}
+
+/*
+ * Add string to FNV-1a hash
+ */
+static uint64_t hash_add(uint64_t hash, const char* string)
+{
+  for (; *string; string++)
+  {
+    hash = (hash ^ (unsigned char) *string) * 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+/*
+ * Build chart of symbol as JSON, with a random walk of prices
+ *
+ * The walk is seeded by the hash of the symbol, range and interval
+ */
+static int chart_json_build(buffer_t* buffer, const char* symbol, const char* range, const char* interval)
+{
+  uint64_t seed = 14695981039346656037ULL;
+
+  seed = hash_add(seed, symbol);
+
+  seed = hash_add(seed, range);
+
+  seed = hash_add(seed, interval);
+
+  long step = interval_seconds_get(interval);
+
+  long end = (time(NULL) / step) * step;
+
+  double* prices = malloc(sizeof(double) * (server_points + 1));
+
+  if (!prices)
+  {
+    return 1;
+  }
+
+  prices[0] = 10.0 + (seed % 49000) / 100.0;
+
+  for (int index = 1; index <= server_points; index++)
+  {
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+
+    double change = ((double) (seed >> 11) / (double) (1ULL << 53) - 0.5) * 0.02;
+
+    prices[index] = prices[index - 1] * (1.0 + change);
+  }
+
+  int status = buffer_printf(buffer,
+    "{\"chart\":{\"result\":[{\"meta\":{\"currency\":\"USD\",\"symbol\":\"%s\","
+    "\"longName\":\"%s Inc\",\"shortName\":\"%s\",\"fullExchangeName\":\"Local\","
+    "\"regularMarketVolume\":%d},\"timestamp\":[", symbol, symbol, symbol, 1000 * server_points);
+
+  for (int index = 0; status == 0 && index < server_points; index++)
+  {
+    status = buffer_printf(buffer, "%s%ld", (index > 0) ? "," : "", end - (server_points - 1 - index) * step);
+  }
+
+  status = status || buffer_printf(buffer, "],\"indicators\":{\"quote\":[{\"volume\":[");
+
+  for (int index = 0; status == 0 && index < server_points; index++)
+  {
+    status = buffer_printf(buffer, "%s%d", (index > 0) ? "," : "", 1000 + (int) (prices[index + 1] * 7) % 1000);
+  }
+
+  // The open is the previous close, and high and low are around them
+  const char* names[] = { "open", "close", "high", "low" };
+
+  for (int name = 0; status == 0 && name < 4; name++)
+  {
+    status = buffer_printf(buffer, "],\"%s\":[", names[name]);
+
+    for (int index = 0; status == 0 && index < server_points; index++)
+    {
+      double open  = prices[index];
+      double close = prices[index + 1];
+
+      double price = (name == 0) ? open : (name == 1) ? close :
+                     (name == 2) ? MAX(open, close) * 1.002 : MIN(open, close) * 0.998;
+
+      status = buffer_printf(buffer, "%s%.2f", (index > 0) ? "," : "", price);
+    }
+  }
+
+  status = status || buffer_printf(buffer, "]}]}}],\"error\":null}}");
+
+  free(prices);
+
+  return status;
+}
+
+/*
+ * Build response of request of client
+ *
+ * Only GET requests of charts are answered with 200,
+ * and everything else with 404
+ */
+static int client_response_build(client_t* client)
+{
+  char method[8] = "";
+
+  char path[SERVER_REQUEST_SIZE] = "";
+
+  sscanf(client->request, "%7s %4095s", method, path);
+
+  buffer_t body = { 0 };
+
+  int code = 404;
+
+  if (strcmp(method, "GET") == 0 && strncmp(path, SERVER_PATH, strlen(SERVER_PATH)) == 0)
+  {
+    char* symbol = path + strlen(SERVER_PATH);
+
+    char* query = strchr(symbol, '?');
+
+    if (query) *query++ = '\0';
+
+    char range[16], interval[16];
+
+    query_value_get(range, sizeof(range), query, "range");
+
+    query_value_get(interval, sizeof(interval), query, "interval");
+
+    size_t symbol_len = strlen(symbol);
+
+    // The symbol is written as is in the JSON
+    bool is_valid = (symbol_len > 0 && symbol_len < 64 && strcspn(symbol, "\"\\") == symbol_len);
+
+    if (is_valid && chart_json_build(&body, symbol, range, interval) == 0)
+    {
+      code = 200;
+    }
+  }
+
+  if (code != 200)
+  {
+    body.length = 0;
+
+    buffer_printf(&body, "{\"chart\":{\"result\":null,\"error\":{\"code\":\"Not Found\"}}}");
+  }
+
+  client->response.length = 0;
+
+  client->response_sent = 0;
+
+  int status = buffer_printf(&client->response,
+    "HTTP/1.1 %d %s\r\nContent-Type: application/json\r\nContent-Length: %zu\r\n\r\n%s",
+    code, (code == 200) ? "OK" : "Not Found", body.length, body.string ? body.string : "");
+
+  free(body.string);
+
+  return status;
+}
+
+/*
+ * Accept every waiting connection
+ */
+static void clients_accept(int server)
+{
+  int client_socket;
+
+  while ((client_socket = accept(server, NULL, NULL)) != -1)
+  {
+    fcntl(client_socket, F_SETFL, O_NONBLOCK);
+
+    client_t* client = malloc(sizeof(client_t));
+
+    client_t** new_clients = realloc(clients, sizeof(client_t*) * (client_count + 1));
+
+    if (!client || !new_clients)
+    {
+      free(client);
+
+      if (new_clients) clients = new_clients;
+
+      close(client_socket);
+
+      continue;
+    }
+
+    memset(client, 0, sizeof(client_t));
+
+    client->socket = client_socket;
+
+    clients = new_clients;
+
+    clients[client_count++] = client;
+  }
+}
+
+/*
+ * Close connection and remove client
+ */
+static void client_remove(size_t index)
+{
+  client_t* client = clients[index];
+
+  close(client->socket);
+
+  free(client->response.string);
+
+  free(client);
+
+  clients[index] = clients[--client_count];
+}
+
+/*
+ * Handle the first request of client, if all of it has been read
+ *
+ * RETURN (int status)
+ * - 0 | Success
+ * - 1 | The connection should be closed
+ */
+static int client_request_handle(client_t* client)
+{
+  // Only one request is answered at a time
+  if (client->is_waiting || client->is_sending)
+  {
+    return 0;
+  }
+
+  char* end = strstr(client->request, "\r\n\r\n");
+
+  if (!end)
+  {
+    // The request doesn't fit in the buffer
+    return (client->request_len >= SERVER_REQUEST_SIZE - 1) ? 1 : 0;
+  }
+
+  if (client_response_build(client) != 0)
+  {
+    return 1;
+  }
+
+  // A following request is kept for after the response
+  size_t request_len = end + 4 - client->request;
+
+  memmove(client->request, end + 4, client->request_len - request_len + 1);
+
+  client->request_len -= request_len;
+
+  client->is_waiting = true;
+
+  client->due = server_time_get() + server_latency;
+
+  return 0;
+}
+
+/*
+ * Read request of client
+ *
+ * RETURN (int status)
+ * - 0 | Success
+ * - 1 | The connection is closed
+ */
+static int client_read(client_t* client)
+{
+  ssize_t length = recv(client->socket, client->request + client->request_len,
+    SERVER_REQUEST_SIZE - 1 - client->request_len, 0);
+
+  if (length == 0 || (length < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+  {
+    return 1;
+  }
+
+  if (length < 0)
+  {
+    return 0;
+  }
+
+  client->request_len += length;
+
+  client->request[client->request_len] = '\0';
+
+  return client_request_handle(client);
+}
+
+/*
+ * Send response of client
+ *
+ * RETURN (int status)
+ * - 0 | Success
+ * - 1 | The connection is closed
+ */
+static int client_write(client_t* client)
+{
+  ssize_t length = send(client->socket, client->response.string + client->response_sent,
+    client->response.length - client->response_sent, MSG_NOSIGNAL);
+
+  if (length < 0)
+  {
+    return (errno == EAGAIN || errno == EWOULDBLOCK) ? 0 : 1;
+  }
+
+  client->response_sent += length;
+
+  if (client->response_sent >= client->response.length)
+  {
+    client->is_sending = false;
+  }
+
+  return 0;
+}
+
+/*
+ * Open listening socket on port of localhost
+ */
+static int server_open(int port)
+{
+  int server = socket(AF_INET, SOCK_STREAM, 0);
+
+  if (server == -1)
+  {
+    return -1;
+  }
+
+  int option = 1;
+
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+
+  struct sockaddr_in address =
+  {
+    .sin_family      = AF_INET,
+    .sin_port        = htons(port),
+    .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+  };
+
+  if (bind(server, (struct sockaddr*) &address, sizeof(address)) != 0 ||
+      listen(server, SOMAXCONN) != 0)
+  {
+    close(server);
+
+    return -1;
+  }
+
+  fcntl(server, F_SETFL, O_NONBLOCK);
+
+  return server;
+}
+
+/*
+ * Serve clients until the server is stopped
+ */
+static int server_run(int server)
+{
+  struct pollfd* fds = NULL;
+
+  size_t fd_size = 0;
+
+  while (true)
+  {
+    if (client_count + 1 > fd_size)
+    {
+      fd_size = (client_count + 1) * 2;
+
+      struct pollfd* new_fds = realloc(fds, sizeof(struct pollfd) * fd_size);
+
+      if (!new_fds)
+      {
+        free(fds);
+
+        return 1;
+      }
+
+      fds = new_fds;
+    }
+
+    long now = server_time_get();
+
+    int timeout = -1;
+
+    fds[0] = (struct pollfd) { .fd = server, .events = POLLIN };
+
+    for (size_t index = 0; index < client_count; index++)
+    {
+      client_t* client = clients[index];
+
+      // The response of a waiting client is sent when it's due
+      if (client->is_waiting && client->due <= now)
+      {
+        client->is_waiting = false;
+
+        client->is_sending = true;
+      }
+
+      if (client->is_waiting)
+      {
+        int wait = client->due - now;
+
+        timeout = (timeout < 0) ? wait : MIN(timeout, wait);
+      }
+
+      short events = client->is_sending ? POLLOUT : client->is_waiting ? 0 : POLLIN;
+
+      fds[index + 1] = (struct pollfd) { .fd = client->socket, .events = events };
+    }
+
+    size_t count = client_count;
+
+    if (poll(fds, count + 1, timeout) < 0 && errno != EINTR)
+    {
+      free(fds);
+
+      return 2;
+    }
+
+    // Clients are removed by swapping with the last, so they are iterated backwards
+    for (size_t index = count; index-- > 0;)
+    {
+      client_t* client = clients[index];
+
+      short revents = fds[index + 1].revents;
+
+      int status = 0;
+
+      if (revents & (POLLERR | POLLNVAL))
+      {
+        status = 1;
+      }
+      else if (client->is_sending && (revents & POLLOUT))
+      {
+        status = client_write(client);
+
+        // A request that came with the previous one is answered next
+        if (status == 0)
+        {
+          status = client_request_handle(client);
+        }
+      }
+      else if (revents & (POLLIN | POLLHUP))
+      {
+        status = client_read(client);
+      }
+
+      if (status != 0)
+      {
+        client_remove(index);
+      }
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+      clients_accept(server);
+    }
+  }
+}
+
+/*
+ * Main function
+ */
+int main(int argc, char* argv[])
+{
+  int port = (argc > 1) ? atoi(argv[1]) : SERVER_PORT;
+
+  server_points = (argc > 2) ? MAX(1, atoi(argv[2])) : SERVER_POINTS;
+
+  server_latency = (argc > 3) ? MAX(0, atoi(argv[3])) : SERVER_LATENCY;
+
+  int server = server_open(port);
+
+  if (server == -1)
+  {
+    fprintf(stderr, "server: Failed to listen on port %d\n", port);
+
+    return 1;
+  }
+
+  fprintf(stderr, "server: Serving %d prices after %d ms on http://127.0.0.1:%d\n",
+    server_points, server_latency, port);
+
+  int status = server_run(server);
+
+  close(server);
+
+  return (status == 0) ? 0 : 2;
+}
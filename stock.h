@@ -3,7 +3,7 @@
  *
  * Written by Hampus Fridholm
  *
- * Last updated: 2025-04-20
+ * Last updated: 2026-10-18
  *
  * https://curl.se/libcurl/c/simple.html
  *
@@ -15,6 +15,9 @@
 #ifndef STOCK_H
 #define STOCK_H
 
+#include <time.h>
+#include <stdint.h>
+
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 #define MIN(a, b) (((a) > (b)) ? (b) : (a))
 
@@ -62,8 +65,26 @@ typedef struct stock_t
   double         _close;
   double         _high;
   double         _low;
+
+  bool           is_stale; // Data is from a snapshot, not yet fetched
+
+  size_t         _refs;    // Shared references (stock_get)
+  size_t         _version; // Changed when data changes, unique among all stocks
+  time_t         _time;    // Time of last fetch
 } stock_t;
 
+/*
+ * Priority of fetch, from most to least urgent
+ */
+typedef enum stock_priority_t
+{
+  STOCK_PRIORITY_CHART,    // The chart the user is looking at
+  STOCK_PRIORITY_VISIBLE,  // Visible list items
+  STOCK_PRIORITY_HIDDEN,   // Off-screen list items
+  STOCK_PRIORITY_PREFETCH, // Speculative prefetch
+  STOCK_PRIORITY_COUNT
+} stock_priority_t;
+
 /*
  * Function declarations
  */
@@ -78,10 +99,125 @@ extern int      stock_update(stock_t* stock);
 
 extern void     stock_free(stock_t** stock);
 
+
+extern stock_t* stock_get(char* symbol);
+
+extern void     stock_put(stock_t** stock);
+
+extern stock_t* stock_snapshot_get(char* symbol, const char* file);
+
+extern int      stock_snapshot_save(stock_t* stock, const char* file);
+
+extern int      stock_revalidate(stock_t* stock, stock_priority_t priority);
+
+extern int      stock_prefetch(stock_t* stock, char* range, stock_priority_t priority);
+
+extern bool     stock_is_fresh(stock_t* stock);
+
+extern int      stock_poll(int timeout);
+
+
+/*
+ * Network mode, for reproducible runs without the network
+ *
+ * RECORD saves every response in a directory, keyed by url,
+ * and REPLAY serves the saved responses instead of fetching them
+ */
+typedef enum stock_network_t
+{
+  STOCK_NETWORK_LIVE,
+  STOCK_NETWORK_RECORD,
+  STOCK_NETWORK_REPLAY
+} stock_network_t;
+
+extern int      stock_network_set(stock_network_t network, const char* dir, int latency);
+
+extern int      stock_url_base_set(const char* base);
+
+extern void     stock_quit(void);
+
+
+/*
+ * Cache of recently used stocks, most recently used first
+ *
+ * The cache keeps the shared stocks alive,
+ * bounded both by the number of stocks and their size in bytes
+ */
+typedef struct stock_cache_t
+{
+  stock_t** stocks;
+  size_t    stock_count;
+  size_t    max_count;
+  size_t    max_size;
+} stock_cache_t;
+
+extern stock_cache_t* stock_cache_create(size_t max_count, size_t max_size);
+
+extern void           stock_cache_delete(stock_cache_t** cache);
+
+extern stock_t*       stock_cache_get(stock_cache_t* cache, char* symbol);
+
+extern int            stock_cache_add(stock_cache_t* cache, stock_t* stock);
+
+
+/*
+ * Metrics of requests, in microseconds
+ *
+ * dns, connect and tls are the durations of each phase,
+ * while ttfb and total are measured from the start of the request
+ */
+typedef enum stock_metric_t
+{
+  STOCK_METRIC_DNS,
+  STOCK_METRIC_CONNECT,
+  STOCK_METRIC_TLS,
+  STOCK_METRIC_TTFB,
+  STOCK_METRIC_TOTAL,
+  STOCK_METRIC_JSON,  // Parsing response to json
+  STOCK_METRIC_PARSE, // Parsing json to stock values
+  STOCK_METRIC_COUNT
+} stock_metric_t;
+
+extern const char* STOCK_METRIC_NAMES[STOCK_METRIC_COUNT];
+
+#define STOCK_HISTOGRAM_SUB_COUNT 8
+#define STOCK_HISTOGRAM_SIZE      256
+
+/*
+ * Histogram with 8 buckets per power of two, like HDR histograms,
+ * so every recorded value keeps a precision of 12.5 %
+ */
+typedef struct stock_histogram_t
+{
+  uint32_t counts[STOCK_HISTOGRAM_SIZE];
+  size_t   count;
+  long     max;
+} stock_histogram_t;
+
+/*
+ * Metrics of the requests of a range
+ */
+typedef struct stock_stats_t
+{
+  const char*       range;
+  stock_histogram_t histograms[STOCK_METRIC_COUNT];
+  size_t            request_count;
+  size_t            error_count;
+  size_t            byte_count;
+  size_t            value_count;
+} stock_stats_t;
+
+extern stock_stats_t* stock_stats_get(size_t index);
+
+extern long           stock_histogram_percentile_get(stock_histogram_t* histogram, double percentile);
+
+extern int            stock_stats_dump(const char* file);
+
 #endif // STOCK_H
 
 #ifdef STOCK_IMPLEMENT
 
+#include <stdio.h>
 #include <curl/curl.h>
 #include <json-c/json.h>
 
@@ -97,6 +233,8 @@ const char* STOCK_INTERVALS[] = { "1m", "15m", "30m", "1h", "1d" };
 
 #define STOCK_INTERVAL_COUNT (sizeof(STOCK_INTERVALS) / sizeof(char*))
 
+const char* STOCK_METRIC_NAMES[STOCK_METRIC_COUNT] = { "dns", "connect", "tls", "ttfb", "total", "json", "parse" };
+
 /*
  * Get index of stock range string
  */
@@ -141,6 +279,156 @@ static inline const char* stock_range_interval_get(const char* range)
   return stock_interval_get(index);
 }
 
+static stock_stats_t stock_stats[STOCK_RANGE_COUNT];
+
+/*
+ * Get metrics of range at index
+ */
+stock_stats_t* stock_stats_get(size_t index)
+{
+  if (index >= STOCK_RANGE_COUNT)
+  {
+    return NULL;
+  }
+
+  stock_stats[index].range = STOCK_RANGES[index];
+
+  return &stock_stats[index];
+}
+
+/*
+ * Get monotonic time in microseconds
+ */
+static inline long stock_clock_get(void)
+{
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return (time.tv_sec * 1000000) + (time.tv_nsec / 1000);
+}
+
+/*
+ * Get index of histogram bucket of value
+ *
+ * Values below 16 have their own buckets, larger values
+ * share bucket with values of the same power of two and 3 top bits
+ */
+static inline size_t stock_histogram_index_get(long value)
+{
+  if (value < STOCK_HISTOGRAM_SUB_COUNT * 2)
+  {
+    return MAX(0, value);
+  }
+
+  int magnitude = 63 - __builtin_clzl(value);
+
+  size_t sub_index = (value >> (magnitude - 3)) & (STOCK_HISTOGRAM_SUB_COUNT - 1);
+
+  size_t index = (magnitude - 2) * STOCK_HISTOGRAM_SUB_COUNT + sub_index;
+
+  return MIN(index, STOCK_HISTOGRAM_SIZE - 1);
+}
+
+/*
+ * Get highest value of histogram bucket at index
+ */
+static inline long stock_histogram_value_get(size_t index)
+{
+  if (index < STOCK_HISTOGRAM_SUB_COUNT * 2)
+  {
+    return index;
+  }
+
+  int magnitude = index / STOCK_HISTOGRAM_SUB_COUNT + 2;
+
+  long sub_index = index % STOCK_HISTOGRAM_SUB_COUNT;
+
+  return ((STOCK_HISTOGRAM_SUB_COUNT + sub_index + 1) << (magnitude - 3)) - 1;
+}
+
+/*
+ * Record value in histogram
+ */
+static inline void stock_histogram_add(stock_histogram_t* histogram, long value)
+{
+  histogram->counts[stock_histogram_index_get(value)]++;
+
+  histogram->count++;
+
+  histogram->max = MAX(histogram->max, value);
+}
+
+/*
+ * Get value at percentile (0 - 100) of histogram
+ *
+ * The value is the highest value of it's bucket, but at most the max value
+ */
+long stock_histogram_percentile_get(stock_histogram_t* histogram, double percentile)
+{
+  if (histogram->count == 0)
+  {
+    return 0;
+  }
+
+  size_t target = MAX(1, (size_t) (histogram->count * percentile / 100 + 0.5));
+
+  size_t count = 0;
+
+  for (size_t index = 0; index < STOCK_HISTOGRAM_SIZE; index++)
+  {
+    count += histogram->counts[index];
+
+    if (count >= target)
+    {
+      return MIN(stock_histogram_value_get(index), histogram->max);
+    }
+  }
+
+  return histogram->max;
+}
+
+/*
+ * Dump metrics of every range that has been requested to file
+ */
+int stock_stats_dump(const char* file)
+{
+  FILE* stream = fopen(file, "w");
+
+  if (!stream)
+  {
+    return 1;
+  }
+
+  for (size_t index = 0; index < STOCK_RANGE_COUNT; index++)
+  {
+    stock_stats_t* stats = stock_stats_get(index);
+
+    if (stats->request_count == 0 && stats->error_count == 0) continue;
+
+    fprintf(stream, "range %s: %zu requests, %zu errors, %zu bytes, %zu values\n",
+      stats->range, stats->request_count, stats->error_count, stats->byte_count, stats->value_count);
+
+    fprintf(stream, "  %-8s %8s %10s %10s %10s %10s\n", "metric", "count", "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+    for (size_t metric = 0; metric < STOCK_METRIC_COUNT; metric++)
+    {
+      stock_histogram_t* histogram = &stats->histograms[metric];
+
+      fprintf(stream, "  %-8s %8zu %10.3f %10.3f %10.3f %10.3f\n",
+        STOCK_METRIC_NAMES[metric], histogram->count,
+        stock_histogram_percentile_get(histogram, 50) / 1000.f,
+        stock_histogram_percentile_get(histogram, 90) / 1000.f,
+        stock_histogram_percentile_get(histogram, 99) / 1000.f,
+        histogram->max / 1000.f);
+    }
+  }
+
+  fclose(stream);
+
+  return 0;
+}
+
 /*
  * Calculate stock start, end, open, close, high and low for 1 day
  */
@@ -274,20 +562,111 @@ int stock_resize(stock_t* stock, size_t count)
   return 0;
 }
 
+/*
+ * In-flight request of an url
+ *
+ * Identical requests share the same object, so that fetching
+ * the same symbol, range and interval only hits the network once
+ */
+typedef struct stock_request_t
+{
+  char*               url;
+  CURL*               curl;
+  char*               response;
+  size_t              response_len;
+  size_t              response_size;
+  struct json_object* json;
+  stock_priority_t    priority;
+  ssize_t             range_index; // Range of metrics
+  long                replay_time; // Milliseconds when replayed response arrives
+  bool                is_running;
+  bool                is_done;
+  size_t              _refs;
+} stock_request_t;
+
+static CURLM*            stock_multi         = NULL;
+
+static stock_request_t** stock_requests      = NULL; // Queued and running requests, oldest first
+static size_t            stock_request_count = 0;
+
+/*
+ * Maximum number of running transfers, in total and per priority
+ *
+ * A request that can't start because of the total limit
+ * preempts a running request of lower priority
+ */
+#define STOCK_REQUEST_LIMIT 8
+
+static const size_t STOCK_PRIORITY_LIMITS[STOCK_PRIORITY_COUNT] = { 8, 6, 4, 2 };
+
+#define STOCK_RESPONSE_SIZE 65536
+
 /*
  * Function for curl to write response
  */
-static inline size_t stock_response_write(void* ptr, size_t size, size_t nmemb, char* response)
+static inline size_t stock_response_write(void* ptr, size_t size, size_t nmemb, stock_request_t* request)
 {
   size_t total_size = size * nmemb;
 
-  strncat(response, ptr, total_size);
+  size_t needed_size = request->response_len + total_size + 1;
+
+  if (needed_size > request->response_size)
+  {
+    size_t new_size = MAX(request->response_size * 2, needed_size);
+
+    char* response = realloc(request->response, sizeof(char) * new_size);
+
+    if (!response)
+    {
+      return 0;
+    }
+
+    request->response      = response;
+    request->response_size = new_size;
+  }
+
+  memcpy(request->response + request->response_len, ptr, total_size);
+
+  request->response_len += total_size;
+
+  request->response[request->response_len] = '\0';
 
   return total_size;
 }
 
 #define STOCK_URL_SIZE 256
-#define STOCK_URL_BASE "https://query1.finance.yahoo.com/v8/finance/chart/"
+#define STOCK_URL_BASE "https://query1.finance.yahoo.com"
+#define STOCK_URL_PATH "/v8/finance/chart/"
+
+static char* stock_url_base = NULL; // STOCK_URL_BASE is used if not set
+
+/*
+ * Set base url of the chart API, for example a local server,
+ * or reset it to Yahoo Finance with NULL
+ */
+int stock_url_base_set(const char* base)
+{
+  char* url_base = base ? strdup(base) : NULL;
+
+  if (base && !url_base)
+  {
+    return 1;
+  }
+
+  // The path of the API begins with a slash
+  size_t length = url_base ? strlen(url_base) : 0;
+
+  while (length > 0 && url_base[length - 1] == '/')
+  {
+    url_base[--length] = '\0';
+  }
+
+  free(stock_url_base);
+
+  stock_url_base = url_base;
+
+  return 0;
+}
 
 /*
  * Create url for fetching stock data
@@ -306,7 +685,12 @@ static inline char* stock_url_create(char* symbol, char* range, char* interval)
     return NULL;
   }
 
-  if (sprintf(url,"%s%s?", STOCK_URL_BASE, symbol) < 0)
+  const char* base = stock_url_base ? stock_url_base : STOCK_URL_BASE;
+
+  int length = snprintf(url, STOCK_URL_SIZE, "%s%s%s?", base, STOCK_URL_PATH, symbol);
+
+  // Leave room for the range and interval
+  if (length < 0 || length >= STOCK_URL_SIZE - 64)
   {
     free(url);
 
@@ -330,592 +714,2142 @@ static inline char* stock_url_create(char* symbol, char* range, char* interval)
   return url;
 }
 
-#define STOCK_RESPONSE_SIZE 1000000
-
 #define STOCK_CURL_HEADER "Mozilla/5.0 (Windows NT 10.0; Win64; x64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/58.0.3029.110 Safari/537.3"
 
 /*
- * Get curl response for a stock
+ * Get curl multi handle, initializing curl the first time
  */
-static inline char* stock_response_get(char* symbol, char* range, char* interval)
+static inline CURLM* stock_multi_get(void)
 {
-  curl_global_init(CURL_GLOBAL_DEFAULT);
-
-  CURL* curl = curl_easy_init();
-
-  if (!curl)
+  if (!stock_multi)
   {
-    curl_global_cleanup();
+    curl_global_init(CURL_GLOBAL_DEFAULT);
 
-    return NULL;
+    stock_multi = curl_multi_init();
   }
 
-  char* response = malloc(sizeof(char) * STOCK_RESPONSE_SIZE);
+  return stock_multi;
+}
 
-  if (!response)
+/*
+ * Get index of in-flight request with url
+ */
+static inline ssize_t stock_request_index_get(const char* url)
+{
+  for (size_t index = 0; index < stock_request_count; index++)
   {
-    curl_global_cleanup();
-
-    return NULL;
+    if (strcmp(stock_requests[index]->url, url) == 0)
+    {
+      return index;
+    }
   }
 
-  memset(response, '\0', sizeof(char) * STOCK_RESPONSE_SIZE);
-
-  char* url = stock_url_create(symbol, range, interval);
+  return -1;
+}
 
-  if (!url)
+/*
+ * Remove request from in-flight requests
+ *
+ * New requests of the same url will then start a new transfer
+ */
+static inline void stock_request_remove(stock_request_t* request)
+{
+  for (size_t index = 0; index < stock_request_count; index++)
   {
-    free(response);
+    if (stock_requests[index] == request)
+    {
+      stock_request_count--;
 
-    curl_global_cleanup();
+      // Keep the order of requests, for them to be started in order
+      memmove(stock_requests + index, stock_requests + index + 1, sizeof(stock_request_t*) * (stock_request_count - index));
 
-    return NULL;
+      return;
+    }
   }
+}
 
-  curl_easy_setopt(curl, CURLOPT_URL, url);
-
-  curl_easy_setopt(curl, CURLOPT_USERAGENT, STOCK_CURL_HEADER);
-
-  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, stock_response_write);
-
-  curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
-
-  CURLcode res = curl_easy_perform(curl);
-
+/*
+ * Free request, and stop transfer if it is still running
+ */
+static inline void stock_request_free(stock_request_t** request)
+{
+  if (!request || !(*request)) return;
 
-  curl_easy_cleanup(curl);
+  if ((*request)->is_running)
+  {
+    trace_async_end("fetch", *request, "cancelled");
+  }
 
-  curl_global_cleanup();
+  if ((*request)->curl)
+  {
+    curl_multi_remove_handle(stock_multi, (*request)->curl);
 
-  free(url);
+    curl_easy_cleanup((*request)->curl);
+  }
 
-  if (res == CURLE_OK)
+  if ((*request)->json)
   {
-    return response;
+    json_object_put((*request)->json);
   }
 
-  free(response);
+  free((*request)->response);
 
-  return NULL;
+  free((*request)->url);
+
+  free(*request);
+
+  *request = NULL;
 }
 
 /*
- * Parse stock name, either longName or shortName, or symbol
+ * Create request of url, to be started by the scheduler
  */
-static inline int stock_name_parse(stock_t* stock, struct json_object* meta)
+static inline stock_request_t* stock_request_create(const char* url, ssize_t range_index, stock_priority_t priority)
 {
-  struct json_object* name = json_object_object_get(meta, "longName");
+  CURLM* multi = stock_multi_get();
 
-  if (name && json_object_is_type(name, json_type_string))
+  if (!multi)
   {
-    stock->name = strdup(json_object_get_string(name));
+    return NULL;
+  }
 
-    return 0;
+  stock_request_t* request = malloc(sizeof(stock_request_t));
+
+  if (!request)
+  {
+    return NULL;
   }
 
-  error_print("Missing 'longName' field: %s", stock->symbol);
+  memset(request, 0, sizeof(stock_request_t));
 
+  request->url = strdup(url);
 
-  name = json_object_object_get(meta, "shortName");
+  request->response = malloc(sizeof(char) * STOCK_RESPONSE_SIZE);
 
-  if (name && json_object_is_type(name, json_type_string))
+  request->curl = curl_easy_init();
+
+  if (!request->url || !request->response || !request->curl)
   {
-    stock->name = strdup(json_object_get_string(name));
+    stock_request_free(&request);
 
-    return 0;
+    return NULL;
   }
 
-  error_print("Missing 'shortName' field: %s", stock->symbol);
+  request->response_size = STOCK_RESPONSE_SIZE;
 
+  request->response[0] = '\0';
 
-  stock->name = strdup(stock->symbol);
+  request->priority = priority;
 
-  return 1;
+  request->range_index = range_index;
+
+  curl_easy_setopt(request->curl, CURLOPT_URL, request->url);
+
+  curl_easy_setopt(request->curl, CURLOPT_USERAGENT, STOCK_CURL_HEADER);
+
+  curl_easy_setopt(request->curl, CURLOPT_WRITEFUNCTION, stock_response_write);
+
+  curl_easy_setopt(request->curl, CURLOPT_WRITEDATA, request);
+
+  curl_easy_setopt(request->curl, CURLOPT_PRIVATE, request);
+
+  return request;
 }
 
 /*
- * Parse stock meta data
+ * Get range of request, for metrics and trace events
  */
-static inline int stock_meta_parse(stock_t* stock, struct json_object* result)
+static inline const char* stock_request_range_get(stock_request_t* request)
 {
-  struct json_object* meta = json_object_object_get(result, "meta");
+  return (request->range_index != -1) ? STOCK_RANGES[request->range_index] : NULL;
+}
 
-  if (!meta)
-  {
-    error_print("Missing 'meta' field: %s", stock->symbol);
+static stock_network_t stock_network         = STOCK_NETWORK_LIVE;
+static char*           stock_network_dir     = NULL;
+static int             stock_network_latency = 0; // Milliseconds of replayed responses
+
+/*
+ * Set network mode, with directory of recordings
+ * and latency of replayed responses in milliseconds
+ */
+int stock_network_set(stock_network_t network, const char* dir, int latency)
+{
+  char* network_dir = dir ? strdup(dir) : NULL;
 
+  if (dir && !network_dir)
+  {
     return 1;
   }
 
+  free(stock_network_dir);
 
-  struct json_object* currency = json_object_object_get(meta, "currency");
+  stock_network_dir = network_dir;
 
-  if (!currency || !json_object_is_type(currency, json_type_string))
-  {
-    error_print("Missing 'currency' field: %s", stock->symbol);
+  stock_network = network;
 
-    return 3;
-  }
+  stock_network_latency = MAX(0, latency);
 
-  stock->currency = strdup(json_object_get_string(currency));
+  return 0;
+}
 
+#define STOCK_RECORDING_PATH_SIZE 256
 
-  if (stock_name_parse(stock, meta) != 0)
+/*
+ * Get path of recording of url
+ *
+ * The file is named by the FNV-1a hash of the url,
+ * and the url is stored on the first line of the file
+ */
+static inline int stock_recording_path_get(char* buffer, size_t size, const char* url)
+{
+  if (!stock_network_dir)
   {
-    error_print("Failed to parse stock name");
+    return 1;
   }
 
+  uint64_t hash = 14695981039346656037ULL;
 
-  struct json_object* exchange = json_object_object_get(meta, "fullExchangeName");
-
-  if (!exchange || !json_object_is_type(exchange, json_type_string))
+  for (const char* letter = url; *letter; letter++)
   {
-    error_print("Missing 'fullExchangeName' field: %s", stock->symbol);
-  }
-
-  stock->exchange = strdup(json_object_get_string(exchange));
-
+    hash ^= (unsigned char) *letter;
 
-  struct json_object* volume = json_object_object_get(meta, "regularMarketVolume");
+    hash *= 1099511628211ULL;
+  }
 
-  if (!volume || !json_object_is_type(volume, json_type_int))
+  if (snprintf(buffer, size, "%s/%016llx", stock_network_dir, (unsigned long long) hash) >= size)
   {
-    error_print("Missing 'regularMarketVolume' field: %s", stock->symbol);
+    return 2;
   }
 
-  stock->volume = json_object_get_int(volume);
-
   return 0;
 }
 
 /*
- * Parse json objects for stock value
+ * Save response of request as recording of it's url
+ *
+ * The recording is written to a temporary file first,
+ * so that a failed write doesn't leave a broken recording
  */
-static inline int stock_value_parse(stock_value_t* value, struct json_object* time, struct json_object* volume, struct json_object* open, struct json_object* close, struct json_object* high, struct json_object* low)
+static inline int stock_recording_save(stock_request_t* request)
 {
-  if (!time || !json_object_is_type(time, json_type_int))
+  char path[STOCK_RECORDING_PATH_SIZE];
+
+  if (stock_recording_path_get(path, sizeof(path), request->url) != 0)
   {
     return 1;
   }
 
-  value->time = json_object_get_int(time);
-
+  char temp_path[STOCK_RECORDING_PATH_SIZE + 4];
 
-  if (!volume || !json_object_is_type(volume, json_type_int))
+  if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= sizeof(temp_path))
   {
-    return 2;
+    return 1;
   }
 
-  value->volume = json_object_get_int(volume);
-
+  FILE* stream = fopen(temp_path, "w");
 
-  if (!open || !json_object_is_type(open, json_type_double))
+  if (!stream)
   {
-    return 3;
+    return 2;
   }
 
-  value->open = json_object_get_double(open);
+  fprintf(stream, "%s\n", request->url);
 
+  fwrite(request->response, sizeof(char), request->response_len, stream);
 
-  if (!close || !json_object_is_type(close, json_type_double))
+  if (fclose(stream) != 0)
   {
-    return 4;
-  }
+    remove(temp_path);
 
-  value->close = json_object_get_double(close);
-
-
-  if (!high || !json_object_is_type(high, json_type_double))
-  {
-    return 5;
+    return 3;
   }
 
-  value->high = json_object_get_double(high);
-
-
-  if (!low || !json_object_is_type(low, json_type_double))
+  if (rename(temp_path, path) != 0)
   {
-    return 6;
-  }
+    remove(temp_path);
 
-  value->low = json_object_get_double(low);
+    return 4;
+  }
 
   return 0;
 }
 
 /*
- * Parse stock values
+ * Load recording of url of request as it's response
  */
-static inline int stock_values_parse(stock_t* stock, struct json_object* result)
+static inline int stock_recording_load(stock_request_t* request)
 {
-  struct json_object* indicators = json_object_object_get(result, "indicators");
+  char path[STOCK_RECORDING_PATH_SIZE];
 
-  if (!indicators)
+  if (stock_recording_path_get(path, sizeof(path), request->url) != 0)
   {
-    error_print("Missing 'indicators' field: %s", stock->symbol);
-
     return 1;
   }
 
+  FILE* stream = fopen(path, "r");
 
-  struct json_object* quote = json_object_object_get(indicators, "quote");
-
-  if (!quote || !json_object_is_type(quote, json_type_array))
+  if (!stream)
   {
-    error_print("Missing 'quote' field: %s", stock->symbol);
-
     return 2;
   }
 
-  quote = json_object_array_get_idx(quote, 0);
+  char* line = NULL;
 
+  size_t line_size = 0;
 
-  struct json_object* time = json_object_object_get(result, "timestamp");
+  ssize_t line_len = getline(&line, &line_size, stream);
 
-  if (!time || !json_object_is_type(time, json_type_array))
+  // The url is compared, in case two urls have the same hash
+  if (line_len <= 0 || strncmp(line, request->url, line_len - 1) != 0 ||
+      request->url[line_len - 1] != '\0')
   {
-    error_print("Missing 'timestamp' field: %s", stock->symbol);
+    free(line);
+
+    fclose(stream);
 
     return 3;
   }
 
+  free(line);
 
-  struct json_object* volume = json_object_object_get(quote, "volume");
-
-  if (!volume || !json_object_is_type(volume, json_type_array))
-  {
-    error_print("Missing quote 'volume' field: %s", stock->symbol);
-
-    return 4;
-  }
+  request->response_len = 0;
 
+  char buffer[4096];
 
-  struct json_object* open = json_object_object_get(quote, "open");
+  size_t read_len;
 
-  if (!open || !json_object_is_type(open, json_type_array))
+  while ((read_len = fread(buffer, sizeof(char), sizeof(buffer), stream)) > 0)
   {
-    error_print("Missing quote 'open' field: %s", stock->symbol);
+    if (stock_response_write(buffer, sizeof(char), read_len, request) != read_len)
+    {
+      fclose(stream);
 
-    return 5;
+      return 4;
+    }
   }
 
+  fclose(stream);
 
-  struct json_object* close = json_object_object_get(quote, "close");
+  return 0;
+}
 
-  if (!close || !json_object_is_type(close, json_type_array))
+/*
+ * Start transfer of request
+ *
+ * A replayed request is not transferred, it is
+ * finished by stock_requests_poll after the latency
+ */
+static inline int stock_request_start(stock_request_t* request)
+{
+  if (stock_network == STOCK_NETWORK_REPLAY)
   {
-    error_print("Missing quote 'close' field: %s", stock->symbol);
-
-    return 6;
+    request->replay_time = stock_clock_get() / 1000 + stock_network_latency;
   }
-
-
-  struct json_object* high = json_object_object_get(quote, "high");
-
-  if (!high || !json_object_is_type(high, json_type_array))
+  else if (curl_multi_add_handle(stock_multi, request->curl) != CURLM_OK)
   {
-    error_print("Missing quote 'high' field: %s", stock->symbol);
-
-    return 7;
+    return 1;
   }
 
+  request->is_running = true;
 
-  struct json_object* low = json_object_object_get(quote, "low");
+  trace_async_begin("fetch", request, stock_request_range_get(request));
 
-  if (!low || !json_object_is_type(low, json_type_array))
-  {
-    error_print("Missing quote 'low' field: %s", stock->symbol);
+  return 0;
+}
 
-    return 8;
-  }
+/*
+ * Stop transfer of request and queue it again
+ *
+ * When the request is started again, the transfer starts over
+ */
+static inline void stock_request_stop(stock_request_t* request)
+{
+  curl_multi_remove_handle(stock_multi, request->curl);
 
-  size_t count = json_object_array_length(open);
+  request->response_len = 0;
 
-  stock->values = malloc(sizeof(stock_value_t) * count);
+  request->response[0] = '\0';
 
-  if (!stock->values)
-  {
-    error_print("Failed to malloc stock values");
+  request->is_running = false;
 
-    return 9;
-  }
+  trace_async_end("fetch", request, "stopped");
+}
 
-  stock->value_count = 0;
+/*
+ * Get running request to preempt in favour of a request with priority
+ *
+ * The request of lowest priority which was queued last is chosen,
+ * because requests are kept in the order they were created
+ */
+static inline stock_request_t* stock_request_victim_get(stock_priority_t priority)
+{
+  stock_request_t* victim = NULL;
 
-  for (size_t index = 0; index < count; index++)
+  for (size_t index = 0; index < stock_request_count; index++)
   {
-    stock_value_t* value = &stock->values[stock->value_count];
+    stock_request_t* request = stock_requests[index];
 
-    if (stock_value_parse(value,
-      json_object_array_get_idx(time, index),
-      json_object_array_get_idx(volume, index),
-      json_object_array_get_idx(open, index),
-      json_object_array_get_idx(close, index),
-      json_object_array_get_idx(high, index),
-      json_object_array_get_idx(low, index)
-    ) == 0)
+    if (request->is_running && request->priority > priority &&
+       (!victim || request->priority >= victim->priority))
     {
-      stock->value_count++;
+      victim = request;
     }
   }
 
-  return 0;
+  return victim;
 }
 
 /*
- * Get stock data from the internet
+ * Start queued requests, most urgent first, within the limits
  */
-static inline int stock_fetch(stock_t* stock)
+static inline void stock_requests_schedule(void)
 {
-  char* response = stock_response_get(stock->symbol, stock->range, stock->interval);
+  size_t running[STOCK_PRIORITY_COUNT] = { 0 };
+
+  size_t total = 0;
 
-  if (!response)
+  for (size_t index = 0; index < stock_request_count; index++)
   {
-    return 1;
-  }
+    stock_request_t* request = stock_requests[index];
 
-  struct json_object* json = json_tokener_parse(response);
-  
-  free(response);
+    if (request->is_running)
+    {
+      running[request->priority]++;
 
-  if (!json)
+      total++;
+    }
+  }
+
+  for (stock_priority_t priority = 0; priority < STOCK_PRIORITY_COUNT; priority++)
   {
-    error_print("json_tokener_parse");
+    for (size_t index = 0; index < stock_request_count; index++)
+    {
+      stock_request_t* request = stock_requests[index];
 
-    return 2;
-  }
+      if (request->is_running || request->priority != priority) continue;
 
-  struct json_object* chart = json_object_object_get(json, "chart");
+      if (running[priority] >= STOCK_PRIORITY_LIMITS[priority]) break;
 
-  if (!chart)
-  {
-    error_print("Missing 'chart' field: %s", stock->symbol);
+      if (total >= STOCK_REQUEST_LIMIT)
+      {
+        stock_request_t* victim = stock_request_victim_get(priority);
 
-    json_object_put(json);
+        // Every running request is at least as urgent
+        if (!victim) return;
 
-    return 3;
-  }
+        stock_request_stop(victim);
 
-  struct json_object* result = json_object_object_get(chart, "result");
+        running[victim->priority]--;
 
-  if (!result || !json_object_is_type(result, json_type_array))
-  {
-    error_print("Missing 'result' field: %s", stock->symbol);
+        total--;
+      }
 
-    json_object_put(json);
+      if (stock_request_start(request) == 0)
+      {
+        running[priority]++;
 
-    return 4;
+        total++;
+      }
+    }
   }
+}
 
-  result = json_object_array_get_idx(result, 0);
+/*
+ * Get request of url, joining an identical in-flight request if there is one
+ *
+ * A joined request is raised to the more urgent of the priorities
+ *
+ * The request must be released with stock_request_put
+ */
+static inline stock_request_t* stock_request_get(const char* url, ssize_t range_index, stock_priority_t priority)
+{
+  ssize_t index = stock_request_index_get(url);
 
-  if (stock_meta_parse(stock, result) != 0)
+  if (index != -1)
   {
-    json_object_put(json);
+    stock_request_t* request = stock_requests[index];
 
-    return 5;
-  }
+    request->priority = MIN(request->priority, priority);
 
-  if (stock_values_parse(stock, result) != 0)
-  {
-    json_object_put(json);
+    request->_refs++;
 
-    return 6;
-  }
+    stock_requests_schedule();
 
-  json_object_put(json);
+    return request;
+  }
 
-  stock_resize(stock, stock->value_count);
+  stock_request_t* request = stock_request_create(url, range_index, priority);
 
-  return 0;
-}
+  if (!request)
+  {
+    return NULL;
+  }
 
-/*
- * Free data of stock
- */
-static inline void stock_data_free(stock_t* stock)
-{
-  free(stock->values);
+  stock_request_t** temp_requests = realloc(stock_requests, sizeof(stock_request_t*) * (stock_request_count + 1));
 
-  free(stock->_values);
+  if (!temp_requests)
+  {
+    stock_request_free(&request);
 
-  free(stock->symbol);
+    return NULL;
+  }
 
-  free(stock->name);
+  stock_requests = temp_requests;
 
-  free(stock->exchange);
+  stock_requests[stock_request_count++] = request;
 
-  free(stock->currency);
+  request->_refs = 1;
 
-  free(stock->range);
+  stock_requests_schedule();
 
-  free(stock->interval);
+  return request;
 }
 
 /*
- * Free stock object
+ * Release request, freeing it when it is no longer used
  */
-void stock_free(stock_t** stock)
+static inline void stock_request_put(stock_request_t** request)
 {
-  if (!stock || !(*stock)) return;
+  if (!request || !(*request)) return;
 
-  stock_data_free(*stock);
+  if (--(*request)->_refs > 0)
+  {
+    *request = NULL;
 
-  free(*stock);
+    return;
+  }
 
-  *stock = NULL;
+  stock_request_remove(*request);
+
+  stock_request_free(request);
 }
 
 /*
- * Zoom existing stock to specified range and update 1d meta data
- *
- * On error, stock is not affected
+ * Record the timings and size of finished transfer
  */
-int stock_zoom(stock_t* stock, char* range)
+static inline void stock_stats_transfer_add(stock_stats_t* stats, CURL* curl)
 {
-  const char* interval = stock_range_interval_get(range);
+  curl_off_t dns = 0, connect = 0, tls = 0, ttfb = 0, total = 0, size = 0;
 
-  if (!interval)
-  {
-    return 1;
-  }
+  curl_easy_getinfo(curl, CURLINFO_NAMELOOKUP_TIME_T,    &dns);
+  curl_easy_getinfo(curl, CURLINFO_CONNECT_TIME_T,       &connect);
+  curl_easy_getinfo(curl, CURLINFO_APPCONNECT_TIME_T,    &tls);
+  curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+  curl_easy_getinfo(curl, CURLINFO_TOTAL_TIME_T,         &total);
+  curl_easy_getinfo(curl, CURLINFO_SIZE_DOWNLOAD_T,      &size);
 
-  stock_t copy = (stock_t)
-  {
-    .symbol   = strdup(stock->symbol),
-    .range    = strdup(range),
-    .interval = strdup(interval),
-  };
+  // The times of curl are from the start, except for reused connections
+  stock_histogram_add(&stats->histograms[STOCK_METRIC_DNS], dns);
 
-  if (stock_update(&copy) != 0)
-  {
-    stock_data_free(&copy);
+  stock_histogram_add(&stats->histograms[STOCK_METRIC_CONNECT], MAX(0, connect - dns));
 
-    return 2;
+  // Only https connections have a tls handshake
+  if (tls > 0)
+  {
+    stock_histogram_add(&stats->histograms[STOCK_METRIC_TLS], MAX(0, tls - connect));
   }
 
-  stock_data_free(stock);
+  stock_histogram_add(&stats->histograms[STOCK_METRIC_TTFB], ttfb);
 
-  *stock = copy;
+  stock_histogram_add(&stats->histograms[STOCK_METRIC_TOTAL], total);
 
-  return 0;
+  stats->byte_count += size;
+
+  stats->request_count++;
 }
 
 /*
- * Update stock by fetching both specified range and 1d meta data
+ * Finish request when transfer is done, parsing the response once for every user
  */
-int stock_update(stock_t* stock)
+static inline void stock_request_finish(stock_request_t* request, CURLcode result)
 {
-  // 1. Fetch and update 1d meta data
-  char* range = "1d";
+  stock_stats_t* stats = (request->range_index != -1) ? stock_stats_get(request->range_index) : NULL;
+
+  trace_async_end("fetch", request, stock_request_range_get(request));
+
+  if (stats && result == CURLE_OK)
+  {
+    if (stock_network == STOCK_NETWORK_REPLAY)
+    {
+      stats->byte_count += request->response_len;
+
+      stats->request_count++;
+    }
+    else stock_stats_transfer_add(stats, request->curl);
+  }
+
+  if (stock_network == STOCK_NETWORK_RECORD && result == CURLE_OK &&
+      stock_recording_save(request) != 0)
+  {
+    error_print("Failed to record response: %s", request->url);
+  }
+
+  curl_multi_remove_handle(stock_multi, request->curl);
+
+  curl_easy_cleanup(request->curl);
+
+  request->curl = NULL;
+
+  request->is_running = false;
+
+  if (result == CURLE_OK)
+  {
+    long start = stock_clock_get();
+
+    trace_begin("json", stock_request_range_get(request));
+
+    request->json = json_tokener_parse(request->response);
+
+    trace_end("json", stock_request_range_get(request));
+
+    if (stats)
+    {
+      stock_histogram_add(&stats->histograms[STOCK_METRIC_JSON], stock_clock_get() - start);
+    }
+
+    if (!request->json)
+    {
+      error_print("json_tokener_parse: %s", request->url);
+    }
+  }
+  else
+  {
+    // In replay mode, a request only fails on a missing recording, which is already logged
+    if (stock_network != STOCK_NETWORK_REPLAY)
+    {
+      error_print("curl: %s: %s", curl_easy_strerror(result), request->url);
+    }
+  }
+
+  if (stats && !request->json)
+  {
+    stats->error_count++;
+  }
+
+  free(request->response);
+
+  request->response = NULL;
+
+  request->is_done = true;
+
+  stock_request_remove(request);
+}
+
+/*
+ * Finish the replayed requests whose latency has passed,
+ * waiting at most timeout milliseconds for the next one
+ *
+ * RETURN (int count)
+ * - number of requests that finished
+ */
+static inline int stock_replays_poll(int timeout)
+{
+  long now = stock_clock_get() / 1000;
+
+  long wait = -1;
+
+  for (size_t index = 0; index < stock_request_count; index++)
+  {
+    stock_request_t* request = stock_requests[index];
+
+    if (!request->is_running) continue;
+
+    long request_wait = MAX(0, request->replay_time - now);
+
+    wait = (wait < 0) ? request_wait : MIN(wait, request_wait);
+  }
+
+  if (wait > 0 && timeout > 0)
+  {
+    wait = MIN(wait, timeout);
+
+    struct timespec sleep_time =
+    {
+      .tv_sec  = wait / 1000,
+      .tv_nsec = (wait % 1000) * 1000000
+    };
+
+    nanosleep(&sleep_time, NULL);
+
+    now = stock_clock_get() / 1000;
+  }
+
+  int count = 0;
+
+  // Finishing a request removes it, so the requests are iterated backwards
+  for (size_t index = stock_request_count; index-- > 0;)
+  {
+    stock_request_t* request = stock_requests[index];
+
+    if (!request->is_running || request->replay_time > now) continue;
+
+    CURLcode result = CURLE_OK;
+
+    if (stock_recording_load(request) != 0)
+    {
+      error_print("Missing recording: %s", request->url);
+
+      result = CURLE_COULDNT_CONNECT;
+    }
+
+    stock_request_finish(request, result);
+
+    count++;
+  }
+
+  return count;
+}
+
+/*
+ * Drive in-flight requests, waiting at most timeout milliseconds for activity
+ *
+ * RETURN (int count)
+ * - number of requests that finished
+ */
+static inline int stock_requests_poll(int timeout)
+{
+  if (!stock_multi)
+  {
+    return 0;
+  }
+
+  stock_requests_schedule();
+
+  if (stock_network == STOCK_NETWORK_REPLAY)
+  {
+    int count = stock_replays_poll(timeout);
+
+    if (count > 0)
+    {
+      stock_requests_schedule();
+    }
+
+    return count;
+  }
+
+  int running = 0;
+
+  curl_multi_perform(stock_multi, &running);
+
+  if (running > 0 && timeout > 0)
+  {
+    curl_multi_wait(stock_multi, NULL, 0, timeout, NULL);
+
+    curl_multi_perform(stock_multi, &running);
+  }
+
+  int count = 0;
+
+  int queued = 0;
+
+  CURLMsg* message;
+
+  while ((message = curl_multi_info_read(stock_multi, &queued)))
+  {
+    if (message->msg != CURLMSG_DONE) continue;
+
+    stock_request_t* request = NULL;
+
+    curl_easy_getinfo(message->easy_handle, CURLINFO_PRIVATE, (char**) &request);
+
+    if (request)
+    {
+      stock_request_finish(request, message->data.result);
+
+      count++;
+    }
+  }
+
+  // Start queued requests in place of the finished ones
+  if (count > 0)
+  {
+    stock_requests_schedule();
+  }
+
+  return count;
+}
+
+/*
+ * Block until request is done, while driving every in-flight request
+ */
+static inline void stock_request_wait(stock_request_t* request)
+{
+  while (!request->is_done)
+  {
+    stock_requests_poll(100);
+  }
+}
+
+/*
+ * Parse stock name, either longName or shortName, or symbol
+ */
+static inline int stock_name_parse(stock_t* stock, struct json_object* meta)
+{
+  struct json_object* name = json_object_object_get(meta, "longName");
+
+  if (name && json_object_is_type(name, json_type_string))
+  {
+    stock->name = strdup(json_object_get_string(name));
+
+    return 0;
+  }
+
+  error_print("Missing 'longName' field: %s", stock->symbol);
+
+
+  name = json_object_object_get(meta, "shortName");
+
+  if (name && json_object_is_type(name, json_type_string))
+  {
+    stock->name = strdup(json_object_get_string(name));
+
+    return 0;
+  }
+
+  error_print("Missing 'shortName' field: %s", stock->symbol);
+
+
+  stock->name = strdup(stock->symbol);
+
+  return 1;
+}
+
+/*
+ * Parse stock meta data
+ */
+static inline int stock_meta_parse(stock_t* stock, struct json_object* result)
+{
+  struct json_object* meta = json_object_object_get(result, "meta");
+
+  if (!meta)
+  {
+    error_print("Missing 'meta' field: %s", stock->symbol);
+
+    return 1;
+  }
+
+
+  struct json_object* currency = json_object_object_get(meta, "currency");
+
+  if (!currency || !json_object_is_type(currency, json_type_string))
+  {
+    error_print("Missing 'currency' field: %s", stock->symbol);
+
+    return 3;
+  }
+
+  stock->currency = strdup(json_object_get_string(currency));
+
+
+  if (stock_name_parse(stock, meta) != 0)
+  {
+    error_print("Failed to parse stock name");
+  }
+
+
+  struct json_object* exchange = json_object_object_get(meta, "fullExchangeName");
+
+  if (!exchange || !json_object_is_type(exchange, json_type_string))
+  {
+    error_print("Missing 'fullExchangeName' field: %s", stock->symbol);
+  }
+
+  stock->exchange = strdup(json_object_get_string(exchange));
+
+
+  struct json_object* volume = json_object_object_get(meta, "regularMarketVolume");
+
+  if (!volume || !json_object_is_type(volume, json_type_int))
+  {
+    error_print("Missing 'regularMarketVolume' field: %s", stock->symbol);
+  }
+
+  stock->volume = json_object_get_int(volume);
+
+  return 0;
+}
+
+/*
+ * Parse json objects for stock value
+ */
+static inline int stock_value_parse(stock_value_t* value, struct json_object* time, struct json_object* volume, struct json_object* open, struct json_object* close, struct json_object* high, struct json_object* low)
+{
+  if (!time || !json_object_is_type(time, json_type_int))
+  {
+    return 1;
+  }
+
+  value->time = json_object_get_int(time);
+
+
+  if (!volume || !json_object_is_type(volume, json_type_int))
+  {
+    return 2;
+  }
+
+  value->volume = json_object_get_int(volume);
+
+
+  if (!open || !json_object_is_type(open, json_type_double))
+  {
+    return 3;
+  }
+
+  value->open = json_object_get_double(open);
+
+
+  if (!close || !json_object_is_type(close, json_type_double))
+  {
+    return 4;
+  }
+
+  value->close = json_object_get_double(close);
+
+
+  if (!high || !json_object_is_type(high, json_type_double))
+  {
+    return 5;
+  }
+
+  value->high = json_object_get_double(high);
+
+
+  if (!low || !json_object_is_type(low, json_type_double))
+  {
+    return 6;
+  }
+
+  value->low = json_object_get_double(low);
+
+  return 0;
+}
+
+/*
+ * Parse stock values
+ */
+static inline int stock_values_parse(stock_t* stock, struct json_object* result)
+{
+  struct json_object* indicators = json_object_object_get(result, "indicators");
+
+  if (!indicators)
+  {
+    error_print("Missing 'indicators' field: %s", stock->symbol);
+
+    return 1;
+  }
+
+
+  struct json_object* quote = json_object_object_get(indicators, "quote");
+
+  if (!quote || !json_object_is_type(quote, json_type_array))
+  {
+    error_print("Missing 'quote' field: %s", stock->symbol);
+
+    return 2;
+  }
+
+  quote = json_object_array_get_idx(quote, 0);
+
+
+  struct json_object* time = json_object_object_get(result, "timestamp");
+
+  if (!time || !json_object_is_type(time, json_type_array))
+  {
+    error_print("Missing 'timestamp' field: %s", stock->symbol);
+
+    return 3;
+  }
+
+
+  struct json_object* volume = json_object_object_get(quote, "volume");
+
+  if (!volume || !json_object_is_type(volume, json_type_array))
+  {
+    error_print("Missing quote 'volume' field: %s", stock->symbol);
+
+    return 4;
+  }
+
+
+  struct json_object* open = json_object_object_get(quote, "open");
+
+  if (!open || !json_object_is_type(open, json_type_array))
+  {
+    error_print("Missing quote 'open' field: %s", stock->symbol);
+
+    return 5;
+  }
+
+
+  struct json_object* close = json_object_object_get(quote, "close");
+
+  if (!close || !json_object_is_type(close, json_type_array))
+  {
+    error_print("Missing quote 'close' field: %s", stock->symbol);
+
+    return 6;
+  }
+
+
+  struct json_object* high = json_object_object_get(quote, "high");
+
+  if (!high || !json_object_is_type(high, json_type_array))
+  {
+    error_print("Missing quote 'high' field: %s", stock->symbol);
+
+    return 7;
+  }
+
+
+  struct json_object* low = json_object_object_get(quote, "low");
+
+  if (!low || !json_object_is_type(low, json_type_array))
+  {
+    error_print("Missing quote 'low' field: %s", stock->symbol);
+
+    return 8;
+  }
+
+  size_t count = json_object_array_length(open);
+
+  stock->values = malloc(sizeof(stock_value_t) * count);
+
+  if (!stock->values)
+  {
+    error_print("Failed to malloc stock values");
+
+    return 9;
+  }
+
+  stock->value_count = 0;
+
+  for (size_t index = 0; index < count; index++)
+  {
+    stock_value_t* value = &stock->values[stock->value_count];
+
+    if (stock_value_parse(value,
+      json_object_array_get_idx(time, index),
+      json_object_array_get_idx(volume, index),
+      json_object_array_get_idx(open, index),
+      json_object_array_get_idx(close, index),
+      json_object_array_get_idx(high, index),
+      json_object_array_get_idx(low, index)
+    ) == 0)
+    {
+      stock->value_count++;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Start fetching stock data from the internet
+ *
+ * The returned request must be finished with stock_fetch_finish
+ */
+static inline stock_request_t* stock_fetch_start(stock_t* stock, stock_priority_t priority)
+{
+  char* url = stock_url_create(stock->symbol, stock->range, stock->interval);
+
+  if (!url)
+  {
+    return NULL;
+  }
+
+  stock_request_t* request = stock_request_get(url, stock_range_index_get(stock->range), priority);
+
+  free(url);
+
+  return request;
+}
+
+/*
+ * Wait for fetch request and parse the stock data, then release the request
+ */
+static inline int stock_fetch_finish(stock_t* stock, stock_request_t** request)
+{
+  if (!request || !(*request))
+  {
+    return 1;
+  }
+
+  stock_request_wait(*request);
+
+  struct json_object* json = (*request)->json;
+
+  if (!json)
+  {
+    stock_request_put(request);
+
+    return 2;
+  }
+
+  struct json_object* chart = json_object_object_get(json, "chart");
+
+  if (!chart)
+  {
+    error_print("Missing 'chart' field: %s", stock->symbol);
+
+    stock_request_put(request);
+
+    return 3;
+  }
+
+  struct json_object* result = json_object_object_get(chart, "result");
+
+  if (!result || !json_object_is_type(result, json_type_array))
+  {
+    error_print("Missing 'result' field: %s", stock->symbol);
+
+    stock_request_put(request);
+
+    return 4;
+  }
+
+  result = json_object_array_get_idx(result, 0);
+
+  long start = stock_clock_get();
+
+  trace_begin("parse", stock->symbol);
+
+  int status = 0;
+
+  if (stock_meta_parse(stock, result) != 0)
+  {
+    status = 5;
+  }
+  else if (stock_values_parse(stock, result) != 0)
+  {
+    status = 6;
+  }
+
+  trace_end("parse", stock->symbol);
+
+  stock_request_put(request);
+
+  if (status != 0)
+  {
+    return status;
+  }
+
+  ssize_t range_index = stock_range_index_get(stock->range);
+
+  if (range_index != -1)
+  {
+    stock_stats_t* stats = stock_stats_get(range_index);
+
+    stock_histogram_add(&stats->histograms[STOCK_METRIC_PARSE], stock_clock_get() - start);
+
+    stats->value_count += stock->value_count;
+  }
+
+  stock_resize(stock, stock->value_count);
+
+  stock->_time = time(NULL);
+
+  return 0;
+}
+
+/*
+ * Get stock data from the internet
+ *
+ * The user is waiting for the data, so it is fetched with highest priority
+ */
+static inline int stock_fetch(stock_t* stock)
+{
+  stock_request_t* request = stock_fetch_start(stock, STOCK_PRIORITY_CHART);
+
+  return stock_fetch_finish(stock, &request);
+}
+
+/*
+ * Free data of stock
+ */
+static inline void stock_data_free(stock_t* stock)
+{
+  free(stock->values);
+
+  free(stock->_values);
+
+  free(stock->symbol);
+
+  free(stock->name);
+
+  free(stock->exchange);
+
+  free(stock->currency);
+
+  free(stock->range);
+
+  free(stock->interval);
+}
+
+static size_t stock_version_count = 0; // Versions handed out to stocks
+
+/*
+ * Get a version that no stock has had before
+ *
+ * A stock that is freed and created again at the same address
+ * doesn't get a version it had before, so stock and version
+ * together always refer to the same data
+ */
+static inline size_t stock_version_next(void)
+{
+  return ++stock_version_count;
+}
+
+/*
+ * Replace data of stock with data of copy, keeping shared references
+ */
+static inline void stock_data_move(stock_t* stock, stock_t* copy)
+{
+  size_t refs = stock->_refs;
+
+  stock_data_free(stock);
+
+  *stock = *copy;
+
+  stock->_refs    = refs;
+  stock->_version = stock_version_next();
+}
+
+/*
+ * Free stock object
+ */
+void stock_free(stock_t** stock)
+{
+  if (!stock || !(*stock)) return;
+
+  stock_data_free(*stock);
+
+  free(*stock);
+
+  *stock = NULL;
+}
+
+/*
+ * Update of stock, fetching both range values and 1d meta data
+ */
+typedef struct stock_update_t
+{
+  stock_t*         stock;
+  size_t           version; // Version of stock when update started
+  stock_t          day;
+  stock_t          copy;
+  stock_request_t* day_request;
+  stock_request_t* copy_request;
+} stock_update_t;
+
+static stock_update_t** stock_updates      = NULL; // Background updates
+static size_t           stock_update_count = 0;
+
+/*
+ * Start update of stock to range
+ *
+ * Both requests are in flight at the same time,
+ * and if the range is 1d, they are the same request
+ */
+static inline int stock_update_start(stock_update_t* update, stock_t* stock, char* range, stock_priority_t priority)
+{
+  char* day_range = "1d";
+
+  const char* day_interval = stock_range_interval_get(day_range);
+
+  const char* interval = stock_range_interval_get(range);
+
+  if (!day_interval || !interval)
+  {
+    return 1;
+  }
+
+  *update = (stock_update_t)
+  {
+    .stock   = stock,
+    .version = stock->_version,
+    .day     = (stock_t)
+    {
+      .symbol   = strdup(stock->symbol),
+      .range    = strdup(day_range),
+      .interval = strdup(day_interval),
+    },
+    .copy    = (stock_t)
+    {
+      .symbol   = strdup(stock->symbol),
+      .range    = strdup(range),
+      .interval = strdup(interval),
+    },
+  };
+
+  update->day_request  = stock_fetch_start(&update->day, priority);
+
+  update->copy_request = stock_fetch_start(&update->copy, priority);
+
+  return 0;
+}
+
+/*
+ * Check if both requests of update are done
+ */
+static inline bool stock_update_is_done(stock_update_t* update)
+{
+  return (!update->day_request  || update->day_request->is_done) &&
+         (!update->copy_request || update->copy_request->is_done);
+}
+
+/*
+ * Finish update of stock, waiting for the requests if needed
+ *
+ * On error, stock is not affected
+ */
+static inline int stock_update_finish(stock_update_t* update)
+{
+  // 1. Update 1d meta data
+  if (stock_fetch_finish(&update->day, &update->day_request) != 0 ||
+      stock_meta_calc(&update->day) != 0)
+  {
+    stock_request_put(&update->copy_request);
+
+    stock_data_free(&update->day);
+
+    stock_data_free(&update->copy);
+
+    return 1;
+  }
+
+  // 2. Update range values
+  if (stock_fetch_finish(&update->copy, &update->copy_request) != 0)
+  {
+    stock_data_free(&update->day);
+
+    stock_data_free(&update->copy);
+
+    return 2;
+  }
+
+  stock_t* copy = &update->copy;
+  stock_t* day  = &update->day;
+
+  // Perserve 1d meta data
+  copy->high  = day->high;
+  copy->low   = day->low;
+  copy->open  = day->open;
+  copy->close = day->close;
+  copy->start = day->start;
+  copy->end   = day->end;
+
+  stock_data_free(day);
+
+  stock_data_move(update->stock, copy);
+
+  return 0;
+}
+
+/*
+ * Zoom existing stock to specified range and update 1d meta data
+ *
+ * On error, stock is not affected
+ */
+int stock_zoom(stock_t* stock, char* range)
+{
+  stock_update_t update;
+
+  if (stock_update_start(&update, stock, range, STOCK_PRIORITY_CHART) != 0)
+  {
+    return 1;
+  }
+
+  if (stock_update_finish(&update) != 0)
+  {
+    return 2;
+  }
+
+  return 0;
+}
+
+/*
+ * Update stock by fetching both specified range and 1d meta data
+ */
+int stock_update(stock_t* stock)
+{
+  return stock_zoom(stock, stock->range);
+}
+
+/*
+ * Create stock with symbol and 1d range data
+ */
+stock_t* stock_create(char* symbol)
+{
+  char* range = "1d";
 
   const char* interval = stock_range_interval_get(range);
 
-  if (!interval)
+  if (!interval)
+  {
+    return NULL;
+  }
+
+  stock_t* stock = malloc(sizeof(stock_t));
+
+  if (!stock)
+  {
+    return NULL;
+  }
+
+  memset(stock, 0, sizeof(stock_t));
+
+  *stock = (stock_t)
+  {
+    .symbol   = strdup(symbol),
+    .range    = strdup(range),
+    .interval = strdup(interval),
+  };
+
+  if (stock_fetch(stock) != 0)
+  {
+    stock_free(&stock);
+
+    return NULL;
+  }
+
+  if (stock_meta_calc(stock) != 0)
+  {
+    stock_free(&stock);
+
+    return NULL;
+  }
+
+  return stock;
+}
+
+/*
+ * Registry of shared stocks, one stock per symbol
+ */
+static stock_t** stock_registry       = NULL;
+static size_t    stock_registry_count = 0;
+
+/*
+ * Find shared stock with symbol
+ */
+static inline stock_t* stock_registry_find(const char* symbol)
+{
+  for (size_t index = 0; index < stock_registry_count; index++)
+  {
+    stock_t* stock = stock_registry[index];
+
+    if (strcmp(stock->symbol, symbol) == 0)
+    {
+      return stock;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Add stock to registry of shared stocks
+ */
+static inline int stock_registry_add(stock_t* stock)
+{
+  stock_t** temp_registry = realloc(stock_registry, sizeof(stock_t*) * (stock_registry_count + 1));
+
+  if (!temp_registry)
+  {
+    return 1;
+  }
+
+  stock_registry = temp_registry;
+
+  stock_registry[stock_registry_count++] = stock;
+
+  stock->_version = stock_version_next();
+
+  return 0;
+}
+
+/*
+ * Remove stock from registry of shared stocks
+ */
+static inline void stock_registry_remove(stock_t* stock)
+{
+  for (size_t index = 0; index < stock_registry_count; index++)
+  {
+    if (stock_registry[index] == stock)
+    {
+      stock_registry[index] = stock_registry[--stock_registry_count];
+
+      break;
+    }
+  }
+
+  if (stock_registry_count == 0)
+  {
+    free(stock_registry);
+
+    stock_registry = NULL;
+  }
+}
+
+/*
+ * Get shared stock with symbol, only creating it if it doesn't exist
+ *
+ * The stock must be released with stock_put
+ */
+stock_t* stock_get(char* symbol)
+{
+  stock_t* stock = stock_registry_find(symbol);
+
+  if (stock)
+  {
+    stock->_refs++;
+
+    return stock;
+  }
+
+  stock = stock_create(symbol);
+
+  if (!stock)
+  {
+    return NULL;
+  }
+
+  if (stock_registry_add(stock) != 0)
+  {
+    stock_free(&stock);
+
+    return NULL;
+  }
+
+  stock->_refs = 1;
+
+  return stock;
+}
+
+/*
+ * Release shared stock, freeing it when it is no longer used
+ */
+void stock_put(stock_t** stock)
+{
+  if (!stock || !(*stock)) return;
+
+  if ((*stock)->_refs > 1)
+  {
+    (*stock)->_refs--;
+
+    *stock = NULL;
+
+    return;
+  }
+
+  stock_registry_remove(*stock);
+
+  stock_free(stock);
+}
+
+#define STOCK_SNAPSHOT_VERSION 1
+
+/*
+ * Read line of snapshot, without the newline
+ *
+ * An empty line is read as NULL
+ */
+static inline int stock_snapshot_line_read(char** line, FILE* stream)
+{
+  char buffer[256];
+
+  if (!fgets(buffer, sizeof(buffer), stream))
+  {
+    return 1;
+  }
+
+  buffer[strcspn(buffer, "\n")] = '\0';
+
+  *line = (*buffer != '\0') ? strdup(buffer) : NULL;
+
+  return 0;
+}
+
+/*
+ * Read stock from snapshot file
+ */
+static inline stock_t* stock_snapshot_read(const char* file)
+{
+  FILE* stream = fopen(file, "r");
+
+  if (!stream)
+  {
+    return NULL;
+  }
+
+  stock_t* stock = malloc(sizeof(stock_t));
+
+  if (!stock)
+  {
+    fclose(stream);
+
+    return NULL;
+  }
+
+  memset(stock, 0, sizeof(stock_t));
+
+  int  version = 0;
+  long time    = 0;
+
+  if (fscanf(stream, "%d\n", &version) != 1 || version != STOCK_SNAPSHOT_VERSION ||
+      stock_snapshot_line_read(&stock->symbol,   stream) != 0 ||
+      stock_snapshot_line_read(&stock->name,     stream) != 0 ||
+      stock_snapshot_line_read(&stock->exchange, stream) != 0 ||
+      stock_snapshot_line_read(&stock->currency, stream) != 0 ||
+      stock_snapshot_line_read(&stock->range,    stream) != 0 ||
+      stock_snapshot_line_read(&stock->interval, stream) != 0 ||
+      !stock->symbol || !stock->range || !stock->interval ||
+      fscanf(stream, "%ld %d %d %d %lf %lf %lf %lf %zu\n", &time,
+        &stock->volume, &stock->start, &stock->end,
+        &stock->open, &stock->close, &stock->high, &stock->low,
+        &stock->value_count) != 9)
+  {
+    fclose(stream);
+
+    stock_free(&stock);
+
+    return NULL;
+  }
+
+  stock->_time = time;
+
+  stock->values = malloc(sizeof(stock_value_t) * MAX(1, stock->value_count));
+
+  if (!stock->values)
+  {
+    fclose(stream);
+
+    stock_free(&stock);
+
+    return NULL;
+  }
+
+  for (size_t index = 0; index < stock->value_count; index++)
+  {
+    stock_value_t* value = &stock->values[index];
+
+    if (fscanf(stream, "%d %d %lf %lf %lf %lf\n", &value->time, &value->volume,
+          &value->high, &value->low, &value->close, &value->open) != 6)
+    {
+      fclose(stream);
+
+      stock_free(&stock);
+
+      return NULL;
+    }
+  }
+
+  fclose(stream);
+
+  if (stock->value_count > 0)
+  {
+    stock_resize(stock, stock->value_count);
+  }
+
+  return stock;
+}
+
+/*
+ * Get shared stock with symbol, creating it from snapshot file
+ * without touching the network if it doesn't exist
+ *
+ * Without a snapshot, the stock has no data at all.
+ * The stock is stale until it has been updated with fetched data,
+ * for example by stock_revalidate, unless the snapshot is still fresh
+ *
+ * The stock must be released with stock_put
+ */
+stock_t* stock_snapshot_get(char* symbol, const char* file)
+{
+  stock_t* stock = stock_registry_find(symbol);
+
+  if (stock)
+  {
+    stock->_refs++;
+
+    return stock;
+  }
+
+  stock = stock_snapshot_read(file);
+
+  // The snapshot must be of the same stock
+  if (stock && strcmp(stock->symbol, symbol) != 0)
+  {
+    stock_free(&stock);
+  }
+
+  if (!stock)
+  {
+    char* range = "1d";
+
+    const char* interval = stock_range_interval_get(range);
+
+    if (!interval || !(stock = malloc(sizeof(stock_t))))
+    {
+      return NULL;
+    }
+
+    *stock = (stock_t)
+    {
+      .symbol   = strdup(symbol),
+      .range    = strdup(range),
+      .interval = strdup(interval),
+    };
+  }
+
+  // A snapshot saved moments ago, when the row was released, is as good as fetched
+  stock->is_stale = !stock_is_fresh(stock);
+
+  if (stock_registry_add(stock) != 0)
+  {
+    stock_free(&stock);
+
+    return NULL;
+  }
+
+  stock->_refs = 1;
+
+  return stock;
+}
+
+/*
+ * Save stock to snapshot file
+ *
+ * The snapshot is written to a temporary file first,
+ * so that a failed write doesn't destroy the last snapshot
+ */
+int stock_snapshot_save(stock_t* stock, const char* file)
+{
+  char temp_file[1024];
+
+  if (snprintf(temp_file, sizeof(temp_file), "%s.tmp", file) >= sizeof(temp_file))
   {
     return 1;
   }
 
-  stock_t day = (stock_t)
+  FILE* stream = fopen(temp_file, "w");
+
+  if (!stream)
   {
-    .symbol   = strdup(stock->symbol),
-    .range    = strdup(range),
-    .interval = strdup(interval),
-  };
+    return 2;
+  }
+
+  fprintf(stream, "%d\n%s\n%s\n%s\n%s\n%s\n%s\n", STOCK_SNAPSHOT_VERSION,
+    stock->symbol,
+    stock->name     ? stock->name     : "",
+    stock->exchange ? stock->exchange : "",
+    stock->currency ? stock->currency : "",
+    stock->range,
+    stock->interval);
+
+  fprintf(stream, "%ld %d %d %d %.17g %.17g %.17g %.17g %zu\n", (long) stock->_time,
+    stock->volume, stock->start, stock->end,
+    stock->open, stock->close, stock->high, stock->low,
+    stock->value_count);
+
+  for (size_t index = 0; index < stock->value_count; index++)
+  {
+    stock_value_t value = stock->values[index];
+
+    fprintf(stream, "%d %d %.17g %.17g %.17g %.17g\n", value.time, value.volume,
+      value.high, value.low, value.close, value.open);
+  }
+
+  if (fclose(stream) != 0)
+  {
+    remove(temp_file);
+
+    return 3;
+  }
+
+  if (rename(temp_file, file) != 0)
+  {
+    remove(temp_file);
+
+    return 4;
+  }
+
+  return 0;
+}
+
+/*
+ * Cancel update of stock, releasing the requests
+ */
+static inline void stock_update_cancel(stock_update_t* update)
+{
+  stock_request_put(&update->day_request);
+
+  stock_request_put(&update->copy_request);
 
-  if (stock_fetch(&day) != 0)
+  stock_data_free(&update->day);
+
+  stock_data_free(&update->copy);
+}
+
+/*
+ * Remove background update and release it's stock
+ */
+static inline void stock_update_remove(size_t index)
+{
+  stock_update_t* update = stock_updates[index];
+
+  stock_updates[index] = stock_updates[--stock_update_count];
+
+  stock_put(&update->stock);
+
+  free(update);
+}
+
+/*
+ * Raise priority of request, if it is less urgent
+ */
+static inline void stock_request_raise(stock_request_t* request, stock_priority_t priority)
+{
+  if (request && request->priority > priority)
+  {
+    request->priority = priority;
+  }
+}
+
+/*
+ * Start background update of shared stock to range
+ */
+static inline int stock_background_start(stock_t* stock, char* range, stock_priority_t priority)
+{
+  // The stock is already being updated, maybe make it more urgent
+  for (size_t index = 0; index < stock_update_count; index++)
   {
-    stock_data_free(&day);
+    stock_update_t* update = stock_updates[index];
+
+    if (update->stock == stock && strcmp(update->copy.range, range) == 0)
+    {
+      stock_request_raise(update->day_request, priority);
+
+      stock_request_raise(update->copy_request, priority);
 
+      stock_requests_schedule();
+
+      return 0;
+    }
+  }
+
+  stock_update_t* update = malloc(sizeof(stock_update_t));
+
+  if (!update)
+  {
     return 1;
   }
 
-  if (stock_meta_calc(&day) != 0)
+  if (stock_update_start(update, stock, range, priority) != 0)
   {
-    stock_data_free(&day);
+    free(update);
 
     return 2;
   }
 
-  // 2. Fetch and update range values
-  stock_t copy = (stock_t)
-  {
-    .symbol   = strdup(stock->symbol),
-    .range    = strdup(stock->range),
-    .interval = strdup(stock->interval),
-  };
+  stock_update_t** temp_updates = realloc(stock_updates, sizeof(stock_update_t*) * (stock_update_count + 1));
 
-  if (stock_fetch(&copy))
+  if (!temp_updates)
   {
-    stock_data_free(&day);
+    stock_update_cancel(update);
 
-    stock_data_free(&copy);
+    free(update);
 
     return 3;
   }
 
-  // Perserve 1d meta data
-  copy.high  = day.high;
-  copy.low   = day.low;
-  copy.open  = day.open;
-  copy.close = day.close;
-  copy.start = day.start;
-  copy.end   = day.end;
-
-  stock_data_free(&day);
+  stock_updates = temp_updates;
 
-  stock_data_free(stock);
+  stock_updates[stock_update_count++] = update;
 
-  *stock = copy;
+  // The update holds a reference, so the stock outlives it
+  stock->_refs++;
 
   return 0;
 }
 
 /*
- * Create stock with symbol and 1d range data
+ * Revalidate shared stock in the background, fetching with priority
+ *
+ * The stock is updated by stock_poll when the fetched data arrives
  */
-stock_t* stock_create(char* symbol)
+int stock_revalidate(stock_t* stock, stock_priority_t priority)
 {
-  char* range = "1d";
+  return stock_background_start(stock, stock->range, priority);
+}
 
-  const char* interval = stock_range_interval_get(range);
+#define STOCK_FRESH_TIME 60
 
-  if (!interval)
+/*
+ * Check if stock data was fetched recently
+ */
+bool stock_is_fresh(stock_t* stock)
+{
+  return stock->_time > 0 && (time(NULL) - stock->_time) < STOCK_FRESH_TIME;
+}
+
+/*
+ * Prefetch range of shared stock in the background,
+ * unless the stock already has fresh data of range
+ *
+ * The stock is zoomed by stock_poll when the fetched data arrives
+ */
+int stock_prefetch(stock_t* stock, char* range, stock_priority_t priority)
+{
+  if (strcmp(stock->range, range) == 0 && stock_is_fresh(stock))
   {
-    return NULL;
+    return 0;
   }
 
-  stock_t* stock = malloc(sizeof(stock_t));
+  return stock_background_start(stock, range, priority);
+}
 
-  if (!stock)
+/*
+ * Drive requests and apply finished background updates,
+ * waiting at most timeout milliseconds for network activity
+ *
+ * RETURN (int count)
+ * - number of stocks that have been updated
+ */
+int stock_poll(int timeout)
+{
+  stock_requests_poll(timeout);
+
+  int count = 0;
+
+  for (size_t index = stock_update_count; index-- > 0;)
+  {
+    stock_update_t* update = stock_updates[index];
+
+    if (!stock_update_is_done(update)) continue;
+
+    // If the stock has been changed meanwhile, the update is outdated
+    if (update->stock->_version != update->version)
+    {
+      stock_update_cancel(update);
+    }
+    else if (stock_update_finish(update) == 0)
+    {
+      count++;
+    }
+
+    stock_update_remove(index);
+  }
+
+  return count;
+}
+
+/*
+ * Get number of bytes used by stock
+ */
+static inline size_t stock_size_get(stock_t* stock)
+{
+  size_t size = sizeof(stock_t);
+
+  size += sizeof(stock_value_t) * (stock->value_count + stock->_value_count);
+
+  char* strings[] = { stock->symbol, stock->name, stock->exchange, stock->range, stock->interval, stock->currency };
+
+  for (size_t index = 0; index < sizeof(strings) / sizeof(char*); index++)
+  {
+    if (strings[index])
+    {
+      size += strlen(strings[index]) + 1;
+    }
+  }
+
+  return size;
+}
+
+/*
+ * Create cache of recently used stocks
+ */
+stock_cache_t* stock_cache_create(size_t max_count, size_t max_size)
+{
+  stock_cache_t* cache = malloc(sizeof(stock_cache_t));
+
+  if (!cache)
   {
     return NULL;
   }
 
-  memset(stock, 0, sizeof(stock_t));
+  memset(cache, 0, sizeof(stock_cache_t));
 
-  *stock = (stock_t)
+  *cache = (stock_cache_t)
   {
-    .symbol   = strdup(symbol),
-    .range    = strdup(range),
-    .interval = strdup(interval),
+    .max_count = max_count,
+    .max_size  = max_size,
   };
 
-  if (stock_fetch(stock) != 0)
+  return cache;
+}
+
+/*
+ * Delete cache, releasing it's stocks
+ */
+void stock_cache_delete(stock_cache_t** cache)
+{
+  if (!cache || !(*cache)) return;
+
+  for (size_t index = 0; index < (*cache)->stock_count; index++)
   {
-    stock_free(&stock);
+    stock_put(&(*cache)->stocks[index]);
+  }
 
-    return NULL;
+  free((*cache)->stocks);
+
+  free(*cache);
+
+  *cache = NULL;
+}
+
+/*
+ * Move stock at index to the front of cache
+ */
+static inline void stock_cache_touch(stock_cache_t* cache, size_t index)
+{
+  stock_t* stock = cache->stocks[index];
+
+  memmove(cache->stocks + 1, cache->stocks, sizeof(stock_t*) * index);
+
+  cache->stocks[0] = stock;
+}
+
+/*
+ * Evict least recently used stocks until cache is within bounds
+ *
+ * The most recently used stock is always kept
+ */
+static inline void stock_cache_trim(stock_cache_t* cache)
+{
+  size_t size = 0;
+
+  for (size_t index = 0; index < cache->stock_count; index++)
+  {
+    size += stock_size_get(cache->stocks[index]);
   }
 
-  if (stock_meta_calc(stock) != 0)
+  while (cache->stock_count > 1 &&
+        (cache->stock_count > cache->max_count || size > cache->max_size))
   {
-    stock_free(&stock);
+    stock_t* stock = cache->stocks[--cache->stock_count];
 
-    return NULL;
+    size -= stock_size_get(stock);
+
+    stock_put(&stock);
+  }
+}
+
+/*
+ * Get recently used stock from cache and mark it as most recently used
+ *
+ * The stock must be released with stock_put
+ */
+stock_t* stock_cache_get(stock_cache_t* cache, char* symbol)
+{
+  for (size_t index = 0; index < cache->stock_count; index++)
+  {
+    stock_t* stock = cache->stocks[index];
+
+    if (strcmp(stock->symbol, symbol) == 0)
+    {
+      stock_cache_touch(cache, index);
+
+      stock->_refs++;
+
+      return stock;
+    }
   }
 
-  return stock;
+  return NULL;
+}
+
+/*
+ * Add shared stock to cache as most recently used
+ *
+ * The cache holds it's own reference to the stock
+ */
+int stock_cache_add(stock_cache_t* cache, stock_t* stock)
+{
+  for (size_t index = 0; index < cache->stock_count; index++)
+  {
+    if (cache->stocks[index] == stock)
+    {
+      stock_cache_touch(cache, index);
+
+      return 0;
+    }
+  }
+
+  stock_t** temp_stocks = realloc(cache->stocks, sizeof(stock_t*) * (cache->stock_count + 1));
+
+  if (!temp_stocks)
+  {
+    return 1;
+  }
+
+  cache->stocks = temp_stocks;
+
+  cache->stocks[cache->stock_count++] = stock;
+
+  stock->_refs++;
+
+  stock_cache_touch(cache, cache->stock_count - 1);
+
+  stock_cache_trim(cache);
+
+  return 0;
+}
+
+/*
+ * Stop in-flight requests and clean up curl
+ */
+void stock_quit(void)
+{
+  while (stock_update_count > 0)
+  {
+    stock_update_cancel(stock_updates[0]);
+
+    stock_update_remove(0);
+  }
+
+  free(stock_updates);
+
+  stock_updates = NULL;
+
+  while (stock_request_count > 0)
+  {
+    stock_request_t* request = stock_requests[0];
+
+    stock_request_remove(request);
+
+    stock_request_free(&request);
+  }
+
+  free(stock_requests);
+
+  stock_requests = NULL;
+
+  if (stock_multi)
+  {
+    curl_multi_cleanup(stock_multi);
+
+    stock_multi = NULL;
+
+    curl_global_cleanup();
+  }
+
+  free(stock_network_dir);
+
+  stock_network_dir = NULL;
+
+  free(stock_url_base);
+
+  stock_url_base = NULL;
 }
 
 #endif // STOCK_IMPLEMENT
@@ -4,6 +4,8 @@
  * Written by Hampus Fridholm
  */
 
+#include <sys/stat.h>
+
 #define TUI_IMPLEMENT
 #include "tui.h"
 
@@ -16,8 +18,11 @@
 #define STOCK_IMPLEMENT
 #include "stock.h"
 
+bool stats_menu_toggle(tui_t* tui);
+
 /*
- * Handle forward tab and backward tab event
+ * Handle forward tab and backward tab event,
+ * F2 for the profile overlay and F3 for the stats menu
  */
 bool tab_event(tui_t* tui, int key)
 {
@@ -29,6 +34,14 @@ bool tab_event(tui_t* tui, int key)
     case KEY_RTAB:
       return tui_tab_backward(tui);
 
+    case KEY_F(2):
+      tui_profile_toggle(tui);
+
+      return true;
+
+    case KEY_F(3):
+      return stats_menu_toggle(tui);
+
     default:
       break;
   }
@@ -41,11 +54,96 @@ bool tab_event(tui_t* tui, int key)
  */
 typedef struct stocks_data_t
 {
-  tui_input_t* input;
-  tui_list_t*  list;
-  stock_t*     stock;
+  tui_input_t*   input;
+  tui_list_t*    list;
+  char**         symbols;       // Symbols of list rows
+  stock_t**      stocks;        // Stocks of list rows, loaded when shown
+  size_t         stock_count;
+  stock_t*       stock;
+  stock_cache_t* cache;         // Recently viewed stocks
+  stock_t*       focus;         // Stock of focused item
+  long           focus_time;    // Milliseconds when item was focused
+  bool           is_prefetched; // Focused item has been prefetched
 } stocks_data_t;
 
+#define STOCKS_CACHE_COUNT 16
+#define STOCKS_CACHE_SIZE  (8 * 1024 * 1024)
+
+#define STOCKS_PREFETCH_DWELL 250 // Milliseconds before prefetching
+#define STOCKS_PREFETCH_SPAN  2   // Neighbors above and below
+
+/*
+ * Get path of snapshot file of stock symbol
+ */
+static int stocks_snapshot_file_get(char* buffer, size_t size, const char* symbol)
+{
+  if (snprintf(buffer, size, "%s/.stocks/snapshots/%s", getenv("HOME"), symbol) >= size)
+  {
+    return 1;
+  }
+
+  return 0;
+}
+
+/*
+ * Get stock of list row, starting from it's last snapshot
+ *
+ * The stock is revalidated in the background with priority,
+ * so the list doesn't wait on the network
+ */
+static stock_t* stocks_row_stock_get(stocks_data_t* data, size_t row, stock_priority_t priority)
+{
+  if (row >= data->stock_count) return NULL;
+
+  stock_t* stock = data->stocks[row];
+
+  if (!stock)
+  {
+    char snapshot_file[256];
+
+    if (stocks_snapshot_file_get(snapshot_file, sizeof(snapshot_file), data->symbols[row]) != 0)
+    {
+      return NULL;
+    }
+
+    stock = stock_snapshot_get(data->symbols[row], snapshot_file);
+
+    if (!stock) return NULL;
+
+    data->stocks[row] = stock;
+  }
+
+  if (!stock_is_fresh(stock))
+  {
+    stock_revalidate(stock, priority);
+  }
+
+  return stock;
+}
+
+/*
+ * Save snapshot of and release shared stock of list row
+ */
+static void stocks_row_stock_put(stocks_data_t* data, size_t row)
+{
+  stock_t* stock = data->stocks[row];
+
+  if (!stock) return;
+
+  char snapshot_file[256];
+
+  if (!stock->is_stale && stock->value_count > 0 &&
+      stocks_snapshot_file_get(snapshot_file, sizeof(snapshot_file), stock->symbol) == 0)
+  {
+    if (stock_snapshot_save(stock, snapshot_file) != 0)
+    {
+      error_print("stock_snapshot_save %s", stock->symbol);
+    }
+  }
+
+  stock_put(&data->stocks[row]);
+}
+
 /*
  * Free function for stocks data
  */
@@ -55,9 +153,20 @@ void stocks_window_free(tui_window_t* window)
 
   tui_list_delete(&data->list);
 
+  for (size_t row = 0; row < data->stock_count; row++)
+  {
+    stocks_row_stock_put(data, row);
+  }
+
+  free(data->stocks);
+
+  file_lines_free(&data->symbols, data->stock_count);
+
   tui_input_delete(&data->input);
 
-  stock_free(&data->stock);
+  stock_put(&data->stock);
+
+  stock_cache_delete(&data->cache);
 
   free(data);
 }
@@ -116,6 +225,23 @@ static inline int grid_stock_y_get(stock_t* stock, int h, double value)
   return (h - 1) - ((double) (h - 1) * (value - stock->_low) / (stock->_high - stock->_low));
 }
 
+#define CHART_RASTER_COUNT 8
+
+/*
+ * Drawn chart, that can be copied to the chart window instead of drawing it again
+ */
+typedef struct chart_raster_t
+{
+  stock_t*                  stock;
+  char*                     symbol;
+  char*                     range;
+  size_t                    version;
+  void                    (*render)(tui_window_t* head);
+  tui_size_t                size;
+  tui_window_grid_square_t* squares;
+  size_t                    time;    // Last use, the least recently used raster is replaced
+} chart_raster_t;
+
 /*
  * Data of stock window
  */
@@ -125,8 +251,29 @@ typedef struct stock_data_t
   int                value_index;
   tui_window_grid_t* chart;
   tui_window_text_t* window;
+  stock_t*           raster_stock;   // Stock that the chart in grid is drawn from
+  size_t             raster_version;
+  tui_size_t         raster_size;
+  void             (*raster_render)(tui_window_t* head);
+  chart_raster_t     rasters[CHART_RASTER_COUNT]; // Recently drawn charts
+  size_t             raster_time;
+  bool               is_fullscreen;
 } stock_data_t;
 
+/*
+ * Free chart raster
+ */
+static void chart_raster_free(chart_raster_t* raster)
+{
+  free(raster->symbol);
+
+  free(raster->range);
+
+  free(raster->squares);
+
+  memset(raster, 0, sizeof(chart_raster_t));
+}
+
 /*
  * Free function for stock data
  */
@@ -134,11 +281,222 @@ void stock_window_free(tui_window_t* head)
 {
   stock_data_t* data = head->data;
 
+  for (size_t index = 0; index < CHART_RASTER_COUNT; index++)
+  {
+    chart_raster_free(&data->rasters[index]);
+  }
+
   free(data);
 }
 
+/*
+ * Check if the chart drawn in grid is still up to date,
+ * otherwise store what the chart is about to be drawn from
+ */
+static bool chart_window_raster_is_valid(tui_window_t* head)
+{
+  stock_data_t* data = head->data;
+
+  stock_t* stock = data->stock;
+
+  tui_size_t size = { .w = head->_rect.w, .h = head->_rect.h };
+
+  if (data->raster_stock == stock &&
+      data->raster_version == stock->_version &&
+      data->raster_size.w == size.w &&
+      data->raster_size.h == size.h &&
+      data->raster_render == head->event.render)
+  {
+    return true;
+  }
+
+  data->raster_stock   = stock;
+  data->raster_version = stock->_version;
+  data->raster_size    = size;
+  data->raster_render  = head->event.render;
+
+  return false;
+}
+
+void chart_window_dots_render(tui_window_t* head);
+
+/*
+ * Get number of stock values shown in chart window
+ *
+ * The line and candle charts use 2 columns per value,
+ * while the dots chart shows 2 values per column.
+ * A stock with fewer values than that is shown as a whole
+ */
+static size_t chart_window_value_count_get(tui_window_t* head)
+{
+  stock_data_t* data = head->data;
+
+  size_t count = (head->event.render == &chart_window_dots_render) ?
+    head->_rect.w * 2 : (head->_rect.w + 1) / 2;
+
+  if (data && data->stock && data->stock->value_count > 0)
+  {
+    count = MIN(count, data->stock->value_count);
+  }
+
+  return count;
+}
+
+/*
+ * Get x of the column of dots showing value at index, counted from the latest value
+ *
+ * The values are spread across the columns, when there are fewer values than columns
+ */
+static int chart_window_dot_x_get(tui_window_t* head, int index)
+{
+  stock_data_t* data = head->data;
+
+  int columns = head->_rect.w * 2;
+
+  int count = data->stock->_value_count;
+
+  if (count <= 1) return columns - 1;
+
+  return columns - 1 - (index * (columns - 1)) / (count - 1);
+}
+
+/*
+ * Get x of the column showing value at index, counted from the latest value
+ */
+static int chart_window_value_x_get(tui_window_t* head, int index)
+{
+  if (head->event.render == &chart_window_dots_render)
+  {
+    return chart_window_dot_x_get(head, index) / 2;
+  }
+
+  return head->_rect.w - 1 - index * 2;
+}
+
+/*
+ * Get recently drawn chart of the chart window
+ *
+ * The chart is identified by the stock, it's range and version,
+ * the chart mode (render function) and the size of the window.
+ * The version is unique among all stocks, so a stock created where
+ * a freed stock used to be doesn't get the rasters of the freed stock
+ */
+static chart_raster_t* chart_raster_get(tui_window_t* head)
+{
+  stock_data_t* data = head->data;
+
+  stock_t* stock = data->stock;
+
+  for (size_t index = 0; index < CHART_RASTER_COUNT; index++)
+  {
+    chart_raster_t* raster = &data->rasters[index];
+
+    if (raster->squares &&
+        raster->stock == stock &&
+        raster->version == stock->_version &&
+        raster->render == head->event.render &&
+        raster->size.w == head->_rect.w &&
+        raster->size.h == head->_rect.h &&
+        strcmp(raster->symbol, stock->symbol) == 0 &&
+        strcmp(raster->range, stock->range) == 0)
+    {
+      raster->time = ++data->raster_time;
+
+      return raster;
+    }
+  }
+
+  return NULL;
+}
+
+/*
+ * Store the chart drawn in chart window,
+ * replacing the least recently used raster
+ */
+static int chart_raster_add(tui_window_t* head)
+{
+  tui_window_grid_t* window = (tui_window_grid_t*) head;
+
+  stock_data_t* data = head->data;
+
+  stock_t* stock = data->stock;
+
+  if (!window->grid || !stock->symbol || !stock->range) return 1;
+
+  chart_raster_t* raster = &data->rasters[0];
+
+  for (size_t index = 1; index < CHART_RASTER_COUNT; index++)
+  {
+    if (data->rasters[index].time < raster->time)
+    {
+      raster = &data->rasters[index];
+    }
+  }
+
+  chart_raster_free(raster);
+
+  size_t square_count = window->_size.w * window->_size.h;
+
+  *raster = (chart_raster_t)
+  {
+    .stock   = stock,
+    .symbol  = strdup(stock->symbol),
+    .range   = strdup(stock->range),
+    .version = stock->_version,
+    .render  = head->event.render,
+    .size    = window->_size,
+    .squares = malloc(sizeof(tui_window_grid_square_t) * square_count),
+    .time    = ++data->raster_time,
+  };
+
+  if (!raster->symbol || !raster->range || !raster->squares)
+  {
+    chart_raster_free(raster);
+
+    return 2;
+  }
+
+  memcpy(raster->squares, window->grid, sizeof(tui_window_grid_square_t) * square_count);
+
+  return 0;
+}
+
+/*
+ * Copy recently drawn chart to chart window, instead of drawing it again
+ *
+ * The stock values are resized as well, because other windows show them
+ */
+static bool chart_window_raster_load(tui_window_t* head)
+{
+  tui_window_grid_t* window = (tui_window_grid_t*) head;
+
+  stock_data_t* data = head->data;
+
+  stock_t* stock = data->stock;
+
+  chart_raster_t* raster = chart_raster_get(head);
+
+  if (!raster) return false;
+
+  if (tui_window_grid_resize(window, raster->size) != 0) return false;
+
+  memcpy(window->grid, raster->squares, sizeof(tui_window_grid_square_t) * raster->size.w * raster->size.h);
+
+  size_t count = chart_window_value_count_get(head);
+
+  if (stock->_value_count != count)
+  {
+    stock_resize(stock, count);
+  }
+
+  return true;
+}
+
 /*
  * Render cursor in chart window with vertical and horizontal lines
+ *
+ * The cursor is drawn in the layer over the chart,
+ * so that moving it doesn't require drawing the chart again
  */
 static void chart_window_cursor_render(tui_window_t* head)
 {
@@ -148,9 +506,14 @@ static void chart_window_cursor_render(tui_window_t* head)
 
   if (!data) return;
 
+  tui_window_grid_layer_clear(window);
+
+  // The cursor is only shown when the chart is active
+  if (head->tui->window != head) return;
+
   stock_t* stock = data->stock;
 
-  if (!stock) return;
+  if (!stock || stock->_value_count == 0) return;
 
   // Update cursor (value_index) based on resized stock
   if (data->value_index >= stock->_value_count)
@@ -158,7 +521,7 @@ static void chart_window_cursor_render(tui_window_t* head)
     data->value_index = stock->_value_count - 1;
   }
 
-  int cursor_x = MAX(0, head->_rect.w - 1 - (int) data->value_index * 2);
+  int cursor_x = MAX(0, chart_window_value_x_get(head, data->value_index));
 
   double value = stock->_values[stock->_value_count - 1 - data->value_index].close;
 
@@ -168,7 +531,7 @@ static void chart_window_cursor_render(tui_window_t* head)
 
   for (int y = 0; y < head->_rect.h; y++)
   {
-    tui_window_grid_square_modify(window, cursor_x, y, (tui_window_grid_square_t)
+    tui_window_grid_layer_modify(window, cursor_x, y, (tui_window_grid_square_t)
     {
       .symbol   = '|',
       .color.fg = color,
@@ -177,14 +540,14 @@ static void chart_window_cursor_render(tui_window_t* head)
 
   for (int x = 0; x < head->_rect.w; x++)
   {
-    tui_window_grid_square_modify(window, x, cursor_y, (tui_window_grid_square_t)
+    tui_window_grid_layer_modify(window, x, cursor_y, (tui_window_grid_square_t)
     {
       .symbol   = '-',
       .color.fg = color,
     });
   }
 
-  tui_window_grid_square_modify(window, cursor_x, cursor_y, (tui_window_grid_square_t)
+  tui_window_grid_layer_modify(window, cursor_x, cursor_y, (tui_window_grid_square_t)
   {
     .symbol   = ' ',
     .color.bg = color,
@@ -206,6 +569,14 @@ void chart_window_line_render(tui_window_t* head)
 
   if (!stock) return;
 
+  // The chart is only drawn again when it has changed, and wasn't drawn recently
+  if (chart_window_raster_is_valid(head) || chart_window_raster_load(head))
+  {
+    chart_window_cursor_render(head);
+
+    return;
+  }
+
   tui_size_t size = { .w = head->_rect.w, .h = head->_rect.h };
 
   if (tui_window_grid_resize(window, size) != 0)
@@ -214,7 +585,7 @@ void chart_window_line_render(tui_window_t* head)
   }
 
   // Limit stock to window size
-  stock_resize(data->stock, (head->_rect.w + 1) / 2);
+  stock_resize(data->stock, chart_window_value_count_get(head));
 
   short color = (stock->_close > stock->_open) ? TUI_COLOR_GREEN : TUI_COLOR_RED;
 
@@ -265,10 +636,12 @@ void chart_window_line_render(tui_window_t* head)
     }
   }
 
-  if (head->tui->window == head)
+  if (chart_raster_add(head) != 0)
   {
-    chart_window_cursor_render(head);
+    error_print("chart_raster_add");
   }
+
+  chart_window_cursor_render(head);
 }
 
 /*
@@ -286,6 +659,14 @@ void chart_window_candle_render(tui_window_t* head)
 
   if (!stock) return;
 
+  // The chart is only drawn again when it has changed, and wasn't drawn recently
+  if (chart_window_raster_is_valid(head) || chart_window_raster_load(head))
+  {
+    chart_window_cursor_render(head);
+
+    return;
+  }
+
   tui_size_t size = { .w = head->_rect.w, .h = head->_rect.h };
 
   if (tui_window_grid_resize(window, size) != 0)
@@ -294,7 +675,7 @@ void chart_window_candle_render(tui_window_t* head)
   }
 
   // Limit stock to window size
-  stock_resize(data->stock, (head->_rect.w + 1) / 2);
+  stock_resize(data->stock, chart_window_value_count_get(head));
 
   for (int index = 0; index < stock->_value_count; index++)
   {
@@ -348,10 +729,143 @@ void chart_window_candle_render(tui_window_t* head)
     }
   }
 
-  if (head->tui->window == head)
+  if (chart_raster_add(head) != 0)
+  {
+    error_print("chart_raster_add");
+  }
+
+  chart_window_cursor_render(head);
+}
+
+/*
+ * Render line chart with braille dots, 2x4 dots per square
+ *
+ * Every column of dots shows a value, connected to the next value,
+ * which makes it show 4 times as many values as the line chart
+ */
+void chart_window_dots_render(tui_window_t* head)
+{
+  tui_window_grid_t* window = (tui_window_grid_t*) head;
+  
+  stock_data_t* data = head->data;
+
+  if (!data) return;
+
+  stock_t* stock = data->stock;
+
+  if (!stock) return;
+
+  // The chart is only drawn again when it has changed, and wasn't drawn recently
+  if (chart_window_raster_is_valid(head) || chart_window_raster_load(head))
   {
     chart_window_cursor_render(head);
+
+    return;
+  }
+
+  tui_size_t size = { .w = head->_rect.w, .h = head->_rect.h };
+
+  if (tui_window_grid_resize(window, size) != 0)
+  {
+    error_print("tui_window_grid_resize");
   }
+
+  // Limit stock to window size
+  stock_resize(data->stock, chart_window_value_count_get(head));
+
+  short color = (stock->_close > stock->_open) ? TUI_COLOR_GREEN : TUI_COLOR_RED;
+
+  int h = head->_rect.h * 4;
+
+  for (int index = 0; index < stock->_value_count; index++)
+  {
+    int x = chart_window_dot_x_get(head, index);
+
+    stock_value_t value = stock->_values[stock->_value_count - 1 - index];
+
+    int y = grid_stock_y_get(stock, h, value.close);
+
+    tui_window_grid_dot_set(window, x, y, color);
+
+    if (index + 1 >= stock->_value_count) break;
+
+    int next_x = chart_window_dot_x_get(head, index + 1);
+
+    stock_value_t next_value = stock->_values[stock->_value_count - 2 - index];
+
+    int next_y = grid_stock_y_get(stock, h, next_value.close);
+
+    int last_x = x;
+    int last_y = y;
+
+    // Connect the dots, column by column, when the values are spread out
+    for (int step_x = x - 1; step_x >= next_x; step_x--)
+    {
+      int step_y = y + (next_y - y) * (x - step_x) / (x - next_x);
+
+      // Fill the dots between last y and step y
+      for (int fill_y = MIN(last_y, step_y) + 1; fill_y < MAX(last_y, step_y); fill_y++)
+      {
+        tui_window_grid_dot_set(window, last_x, fill_y, color);
+      }
+
+      if (step_x > next_x)
+      {
+        tui_window_grid_dot_set(window, step_x, step_y, color);
+      }
+
+      last_x = step_x;
+      last_y = step_y;
+    }
+  }
+
+  if (chart_raster_add(head) != 0)
+  {
+    error_print("chart_raster_add");
+  }
+
+  chart_window_cursor_render(head);
+}
+
+/*
+ * Mark stock window as dirty, when the stock data of the chart has changed
+ */
+static void chart_window_stock_dirty_set(tui_window_t* head)
+{
+  tui_window_t* stock_window = tui_window_window_search(head, ". . . . stock");
+
+  tui_window_dirty_set(stock_window);
+}
+
+/*
+ * Make the chart fullscreen by hiding the stocks and data windows
+ *
+ * The chart is drawn again at the new size from the loaded stock values.
+ * The price labels are updated after the layout, when the prices window
+ * has got it's new height
+ */
+static void chart_window_fullscreen_set(tui_window_t* head, bool is_fullscreen)
+{
+  stock_data_t* data = head->data;
+
+  if (data->is_fullscreen == is_fullscreen) return;
+
+  data->is_fullscreen = is_fullscreen;
+
+  char* searches[] = { ". . . . stocks", ". . . data" };
+
+  for (size_t index = 0; index < 2; index++)
+  {
+    tui_window_t* window = tui_window_window_search(head, searches[index]);
+
+    if (!window) continue;
+
+    window->is_hidden = is_fullscreen;
+
+    tui_window_layout_dirty_set(window);
+  }
+
+  tui_dirty_set(head->tui);
 }
 
 /*
@@ -370,13 +884,17 @@ bool chart_window_key(tui_window_t* head, int key)
   switch (key)
   {
     case KEY_SPACE:
-      if (head->event.render == &chart_window_candle_render)
+      if (head->event.render == &chart_window_line_render)
       {
-        head->event.render = &chart_window_line_render;
+        head->event.render = &chart_window_candle_render;
+      }
+      else if (head->event.render == &chart_window_candle_render)
+      {
+        head->event.render = &chart_window_dots_render;
       }
       else
       {
-        head->event.render = &chart_window_candle_render;
+        head->event.render = &chart_window_line_render;
       }
       return true;
 
@@ -385,6 +903,8 @@ bool chart_window_key(tui_window_t* head, int key)
       {
         data->value_index--;
 
+        tui_window_dirty_set((tui_window_t*) data->window);
+
         return true;
       }
 
@@ -397,6 +917,8 @@ bool chart_window_key(tui_window_t* head, int key)
       {
         data->value_index++;
 
+        tui_window_dirty_set((tui_window_t*) data->window);
+
         return true;
       }
 
@@ -404,13 +926,29 @@ bool chart_window_key(tui_window_t* head, int key)
 
       return false;
 
+    case 'f':
+      chart_window_fullscreen_set(head, !data->is_fullscreen);
+
+      return true;
+
     case KEY_ESC:
+      // Leave fullscreen before leaving the chart
+      if (data->is_fullscreen)
+      {
+        chart_window_fullscreen_set(head, false);
+
+        return true;
+      }
+
       tui_window_parent_t* stocks_window = tui_window_window_parent_search(head, ". . . . stocks");
 
       if (stocks_window)
       {
         tui_window_set(head->tui, (tui_window_t*) stocks_window);
 
+        // The cursor value is only shown when the chart is active
+        tui_window_dirty_set((tui_window_t*) data->window);
+
         return true;
       }
 
@@ -419,31 +957,43 @@ bool chart_window_key(tui_window_t* head, int key)
     case 'u':
       stock_update(stock);
 
+      chart_window_stock_dirty_set(head);
+
       return true;
 
     case 'd':
       stock_zoom(stock, "1d");
 
+      chart_window_stock_dirty_set(head);
+
       return true;
 
     case 'w':
       stock_zoom(stock, "1wk");
 
+      chart_window_stock_dirty_set(head);
+
       return true;
 
     case 'm':
       stock_zoom(stock, "1mo");
 
+      chart_window_stock_dirty_set(head);
+
       return true;
 
     case 'y':
       stock_zoom(stock, "1y");
 
+      chart_window_stock_dirty_set(head);
+
       return true;
 
     case 'x':
       stock_zoom(stock, "max");
 
+      chart_window_stock_dirty_set(head);
+
       return true;
 
     default:
@@ -477,6 +1027,8 @@ void range_window_update(tui_window_t* head)
 
 /*
  * Update event for prices window, resize height and update prices
+ *
+ * The labels are kept between updates, and only created when the window grows
  */
 void prices_window_update(tui_window_t* head)
 {
@@ -490,26 +1042,45 @@ void prices_window_update(tui_window_t* head)
 
   if (!stock) return;
 
-  // 1. Free all child windows
-  tui_windows_free(&window->children, &window->child_count);
+  size_t lines = (head->_rect.h + 1) / 2;
+
+  // 1. Create the labels that are missing
+  while (window->child_count < lines)
+  {
+    if (!tui_parent_child_text_create(window, (tui_window_text_config_t) { .rect = TUI_RECT_NONE }))
+    {
+      error_print("tui_parent_child_text_create");
 
-  int lines = (head->_rect.h + 1) / 2;
+      break;
+    }
+  }
 
+  // 2. Hide the labels that are left over, and set the price of the others
   char buffer[64];
 
-  for (int index = 0; index < lines; index++)
+  for (size_t index = 0; index < window->child_count; index++)
   {
+    tui_window_text_t* label = (tui_window_text_t*) window->children[index];
+
+    bool is_hidden = (index >= lines);
+
+    if (label->head.is_hidden != is_hidden)
+    {
+      label->head.is_hidden = is_hidden;
+
+      tui_window_layout_dirty_set((tui_window_t*) label);
+    }
+
+    if (is_hidden) continue;
+
     double fraction = ((float) ((lines - 1) - index) / (float) (lines - 1));
 
     double price = fraction * (stock->_high - stock->_low) + stock->_low;
 
     sprintf(buffer, " %.2f ", price);
 
-    tui_parent_child_text_create(window, (tui_window_text_config_t)
-    {
-      .rect   = TUI_RECT_NONE,
-      .string = buffer,
-    });
+    // Only the labels with another price are changed
+    tui_window_text_string_set(label, buffer);
   }
 }
 
@@ -862,6 +1433,7 @@ void chart_prices_init(tui_window_t* head)
     .has_gap      = true,
     .is_contain   = true,
     .event.update = &prices_window_update,
+    .event.resize = &prices_window_update,
     .data         = data,
   });
 
@@ -985,6 +1557,7 @@ void stock_window_init(tui_window_t* head)
     .rect         = TUI_RECT_NONE,
     .color.fg     = TUI_COLOR_WHITE,
     .event.init   = &data_window_init,
+    .event.update = &data_window_fill,
     .has_padding  = true,
     .has_gap      = true,
     .data         = data,
@@ -1001,6 +1574,11 @@ bool item_window_key(tui_window_t* head, int key)
 {
   stock_t* stock = head->data;
 
+  if (!stock)
+  {
+    return false;
+  }
+
   tui_window_parent_t* stock_window = tui_window_window_parent_search(head, ". . . stock");
 
   if (!stock_window)
@@ -1015,23 +1593,52 @@ bool item_window_key(tui_window_t* head, int key)
     return false;
   }
 
+  stocks_data_t* stocks_data = head->parent ? head->parent->head.data : NULL;
+
   switch (key)
   {
     case KEY_ENTR:
       if (data->chart)
       {
-        stock_zoom(stock, "1d");
+        // Without any data, the chart has to wait for it
+        if (stock->value_count == 0)
+        {
+          if (stock_zoom(stock, "1d") != 0)
+          {
+            return false;
+          }
+        }
+        // Prefetched data is shown at once and revalidated in the background
+        else if (strcmp(stock->range, "1d") == 0)
+        {
+          if (!stock_is_fresh(stock))
+          {
+            stock_revalidate(stock, STOCK_PRIORITY_CHART);
+          }
+        }
+        else
+        {
+          stock_zoom(stock, "1d");
+        }
+
+        // The chart holds it's own reference, which is released when another stock is shown
+        if (stocks_data)
+        {
+          stock_cache_add(stocks_data->cache, stock);
+
+          stock_t* last_stock = stocks_data->stock;
+
+          stocks_data->stock = stock_get(stock->symbol);
+
+          stock_put(&last_stock);
+        }
 
         data->stock = stock;
 
         tui_window_set(head->tui, (tui_window_t*) data->chart);
 
-        tui_window_parent_t* data_window = tui_window_window_parent_search((tui_window_t*) stock_window, "data");
-
-        if (data_window)
-        {
-          data_window_fill((tui_window_t*) data_window);
-        }
+        // Both the chart and the borders of the items have changed
+        tui_dirty_set(head->tui);
 
         return true;
       }
@@ -1045,17 +1652,6 @@ bool item_window_key(tui_window_t* head, int key)
   return false;
 }
 
-/*
- * Free function for item window stock object
- */
-void item_window_free(tui_window_t* head)
-{
-  if (head->data)
-  {
-    stock_free((stock_t**) &head->data);
-  }
-}
-
 /*
  * Render item window, white border when viewing it's chart
  */
@@ -1125,13 +1721,23 @@ void item_window_update(tui_window_t* head)
     sprintf(buffer, "%s   ", stock->symbol);
 
     tui_window_text_string_set(symbol_window, buffer);
+
+    // Stale stocks are marked until fresh data has arrived
+    symbol_window->head.color.fg = stock->is_stale ? TUI_COLOR_BLUE : TUI_COLOR_NONE;
   }
 
   tui_window_text_t* price_window = tui_window_window_text_search((tui_window_t*) item_window, "value price");
 
   if (price_window)
   {
-    sprintf(buffer, "%.2f", stock->close);
+    if (stock->value_count > 0)
+    {
+      sprintf(buffer, "%.2f", stock->close);
+    }
+    else
+    {
+      strcpy(buffer, "-");
+    }
 
     tui_window_text_string_set(price_window, buffer);
   }
@@ -1140,7 +1746,14 @@ void item_window_update(tui_window_t* head)
 
   if (diff_window)
   {
-    sprintf(buffer, "%+.2f", stock->close - stock->open);
+    if (stock->value_count > 0)
+    {
+      sprintf(buffer, "%+.2f", stock->close - stock->open);
+    }
+    else
+    {
+      strcpy(buffer, "-");
+    }
 
     tui_window_text_string_set(diff_window, buffer);
 
@@ -1155,10 +1768,6 @@ void item_window_init(tui_window_t* head)
 {
   tui_window_parent_t* item_window = (tui_window_parent_t*) head;
 
-  stock_t* stock = head->data;
-
-  if (!stock) return;
-
   tui_parent_child_text_create(item_window, (tui_window_text_config_t)
   {
     .name  = "symbol",
@@ -1265,7 +1874,56 @@ bool list_window_key(tui_window_t* head, int key)
 }
 
 /*
- * Initialize list window, creating item windows for default stocks
+ * Create item window for the pool of the list
+ */
+tui_window_t* list_window_item_create(tui_list_t* list)
+{
+  tui_window_parent_t* list_window = list->data;
+
+  return (tui_window_t*) tui_parent_child_parent_create(list_window, (tui_window_parent_config_t)
+  {
+    .name         = "item",
+    .rect         = TUI_RECT_NONE,
+    .border       = (tui_border_t)
+    {
+      .is_active  = true,
+    },
+    .event.init   = &item_window_init,
+    .event.key    = &item_window_key,
+    .event.update = &item_window_update,
+    .event.render = &item_window_render,
+    .align        = TUI_ALIGN_BETWEEN,
+    .w_grow       = true,
+    .is_atomic    = true,
+  });
+}
+
+/*
+ * Bind item window to the stock of list row
+ */
+void list_window_row_render(tui_list_t* list, tui_window_t* item, size_t row)
+{
+  tui_window_t* list_window = list->data;
+
+  item->data = stocks_row_stock_get(list_window->data, row, STOCK_PRIORITY_VISIBLE);
+}
+
+/*
+ * Unbind item window from list row, saving and releasing the stock of the row
+ */
+void list_window_row_release(tui_list_t* list, tui_window_t* item, size_t row)
+{
+  tui_window_t* list_window = list->data;
+
+  item->data = NULL;
+
+  stocks_row_stock_put(list_window->data, row);
+}
+
+/*
+ * Initialize list window, creating a virtual list of default stocks
+ *
+ * Only the stocks of the visable rows are loaded
  */
 void list_window_init(tui_window_t* head)
 {
@@ -1279,41 +1937,36 @@ void list_window_init(tui_window_t* head)
 
   size_t file_size = file_size_get(stocks_file);
 
-  char** symbols = NULL;
+  size_t count = file_lines_read(&data->symbols, file_size, stocks_file);
 
-  size_t count = file_lines_read(&symbols, file_size, stocks_file);
+  data->stocks = malloc(sizeof(stock_t*) * MAX(1, count));
 
-  for (size_t index = 0; index < count; index++)
+  if (!data->stocks)
   {
-    char* symbol = symbols[index];
+    file_lines_free(&data->symbols, count);
 
-    stock_t* stock = stock_create(symbol);
+    return;
+  }
 
-    if (!stock) continue;
+  memset(data->stocks, 0, sizeof(stock_t*) * MAX(1, count));
 
-    tui_window_parent_t* item_window = tui_parent_child_parent_create(list_window, (tui_window_parent_config_t)
-    {
-      .name         = symbol,
-      .rect         = TUI_RECT_NONE,
-      .border       = (tui_border_t)
-      {
-        .is_active  = true,
-      },
-      .event.init   = &item_window_init,
-      .event.free   = &item_window_free,
-      .event.key    = &item_window_key,
-      .event.update = &item_window_update,
-      .event.render = &item_window_render,
-      .data         = stock,
-      .align        = TUI_ALIGN_BETWEEN,
-      .w_grow       = true,
-      .is_atomic    = true,
-    });
+  data->stock_count = count;
 
-    tui_list_item_add(data->list, (tui_window_t*) item_window);
-  }
+  char snapshot_dir[64];
+
+  sprintf(snapshot_dir, "%s/.stocks/snapshots", getenv("HOME"));
 
-  file_lines_free(&symbols, count);
+  mkdir(snapshot_dir, 0755);
+
+  data->list = tui_list_virtual_create(head->tui, (tui_list_virtual_config_t)
+  {
+    .is_vertical = list_window->is_vertical,
+    .row_count   = count,
+    .item_create = &list_window_item_create,
+    .row_render  = &list_window_row_render,
+    .row_release = &list_window_row_release,
+    .data        = list_window,
+  });
 
   // Creating invisable window to give list window some min structure
   tui_parent_child_text_create(list_window, (tui_window_text_config_t)
@@ -1386,33 +2039,45 @@ bool search_window_key(tui_window_t* head, int key)
   {
     char* symbol = data->input->buffer;
 
-    stock_t* stock = stock_create(symbol);
+    // A recently searched stock is shown at once and revalidated in the background
+    stock_t* stock = stock_cache_get(data->cache, symbol);
 
-    if (!stock)
+    if (stock)
     {
-      return true;
+      stock_revalidate(stock, STOCK_PRIORITY_CHART);
+    }
+    else
+    {
+      // If the stock is already shared, it will not be fetched again
+      stock = stock_get(symbol);
+
+      if (!stock)
+      {
+        return true;
+      }
+
+      stock_cache_add(data->cache, stock);
     }
 
-    stock_free(&data->stock);
+    stock_put(&data->stock);
 
     data->stock = stock;
 
     stock_data->stock = data->stock;
 
+    // The last stock might have been freed, and another stock allocated in it's place
+    stock_data->raster_stock = NULL;
+
     tui_window_grid_t* chart_window = stock_data->chart;
 
     if (chart_window)
     {
       tui_window_set(head->tui, (tui_window_t*) chart_window);
-
-      tui_window_parent_t* data_window = tui_window_window_parent_search((tui_window_t*) stock_window, "data");
-
-      if (data_window)
-      {
-        data_window_fill((tui_window_t*) data_window);
-      }
     }
 
+    // Both the chart and the borders of the items have changed
+    tui_dirty_set(head->tui);
+
     return true;
   }
 
@@ -1480,7 +2145,7 @@ void stocks_window_init(tui_window_t* head)
 
   head->data = data;
 
-  data->list  = tui_list_create(head->tui, stocks_window->is_vertical);
+  data->cache = stock_cache_create(STOCKS_CACHE_COUNT, STOCKS_CACHE_SIZE);
 
   tui_parent_child_parent_create(stocks_window, (tui_window_parent_config_t)
   {
@@ -1511,6 +2176,7 @@ void stocks_window_init(tui_window_t* head)
     .event.key    = &list_window_key,
     .event.enter  = &list_window_enter,
     .event.update = &list_window_update,
+    .event.resize = &list_window_update,
     .is_vertical  = true,
     .h_grow       = true,
     .border       = (tui_border_t)
@@ -1582,6 +2248,121 @@ void menu_init(tui_menu_t* menu)
   });
 }
 
+/*
+ * Update stats window with the request metrics of every range
+ */
+void stats_window_update(tui_window_t* head)
+{
+  tui_window_text_t* window = (tui_window_text_t*) head;
+
+  char buffer[4096];
+
+  size_t length = snprintf(buffer, sizeof(buffer), "%-8s %7s %9s %9s %9s %9s\n",
+    "metric", "count", "p50 ms", "p90 ms", "p99 ms", "max ms");
+
+  stock_stats_t* stats;
+
+  for (size_t index = 0; (stats = stock_stats_get(index)); index++)
+  {
+    if (stats->request_count == 0 && stats->error_count == 0) continue;
+
+    length += snprintf(buffer + length, sizeof(buffer) - length, "\n%s: %zu requests, %zu errors, %zu bytes, %zu values\n",
+      stats->range, stats->request_count, stats->error_count, stats->byte_count, stats->value_count);
+
+    for (size_t metric = 0; metric < STOCK_METRIC_COUNT && length < sizeof(buffer); metric++)
+    {
+      stock_histogram_t* histogram = &stats->histograms[metric];
+
+      length += snprintf(buffer + length, sizeof(buffer) - length, "%-8s %7zu %9.3f %9.3f %9.3f %9.3f\n",
+        STOCK_METRIC_NAMES[metric], histogram->count,
+        stock_histogram_percentile_get(histogram, 50) / 1000.f,
+        stock_histogram_percentile_get(histogram, 90) / 1000.f,
+        stock_histogram_percentile_get(histogram, 99) / 1000.f,
+        histogram->max / 1000.f);
+    }
+
+    if (length >= sizeof(buffer)) break;
+  }
+
+  tui_window_text_string_set(window, buffer);
+}
+
+/*
+ * Keypress handler for stats window, escape will go back to the stocks
+ */
+bool stats_window_key(tui_window_t* head, int key)
+{
+  if (key == KEY_ESC)
+  {
+    return stats_menu_toggle(head->tui);
+  }
+
+  return false;
+}
+
+/*
+ * Initialize stats menu by creating stats window
+ */
+void stats_menu_init(tui_menu_t* menu)
+{
+  tui_window_parent_t* stats_window = tui_menu_window_parent_create(menu, (tui_window_parent_config_t)
+  {
+    .name        = "stats",
+    .rect        = TUI_PARENT_RECT,
+    .event.key   = &stats_window_key,
+    .is_vertical = true,
+    .border      = (tui_border_t)
+    {
+      .is_active = true,
+      .color.fg  = TUI_COLOR_WHITE,
+    },
+    .has_padding = true,
+    .is_interact = true,
+  });
+
+  tui_parent_child_text_create(stats_window, (tui_window_text_config_t)
+  {
+    .string = " Stats ",
+    .rect   = (tui_rect_t)
+    {
+      .w    = TUI_PARENT_W,
+      .h    = 1,
+    },
+    .align  = TUI_ALIGN_CENTER,
+  });
+
+  tui_parent_child_text_create(stats_window, (tui_window_text_config_t)
+  {
+    .name         = "text",
+    .rect         = TUI_RECT_NONE,
+    .event.update = &stats_window_update,
+    .w_grow       = true,
+    .h_grow       = true,
+  });
+}
+
+/*
+ * Switch between the stocks menu and the stats menu
+ */
+bool stats_menu_toggle(tui_t* tui)
+{
+  char* name = (tui->menu && strcmp(tui->menu->name, "stats") == 0) ? "stocks" : "stats";
+
+  for (size_t index = 0; index < tui->menu_count; index++)
+  {
+    tui_menu_t* menu = tui->menus[index];
+
+    if (strcmp(menu->name, name) == 0)
+    {
+      tui_menu_set(tui, menu);
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
 /*
  * Initialize tui
  */
@@ -1589,13 +2370,113 @@ void tui_init(tui_t* tui)
 {
   tui_menu_t* menu = tui_menu_create(tui, (tui_menu_config_t)
   {
+    .name       = "stocks",
     .event.init = &menu_init,
   });
 
+  tui_menu_create(tui, (tui_menu_config_t)
+  {
+    .name       = "stats",
+    .event.init = &stats_menu_init,
+  });
+
   // Set list window as the active window
   tui_menu_window_search_set(menu, "root stocks list");
 }
 
+/*
+ * Get monotonic time in milliseconds
+ */
+static long stocks_time_get(void)
+{
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return (time.tv_sec * 1000) + (time.tv_nsec / 1000000);
+}
+
+/*
+ * Prefetch chart data of focused item and its neighbors,
+ * when the focus has rested on the item for a while
+ *
+ * The stock shown in the chart is skipped, to not zoom it
+ */
+static void stocks_prefetch(stocks_data_t* data, stock_t* chart_stock)
+{
+  tui_list_t* list = data->list;
+
+  if (!list || list->item_count == 0) return;
+
+  size_t row = tui_list_row_get(list);
+
+  stock_t* focus = list->items[list->item_index]->data;
+
+  long time = stocks_time_get();
+
+  if (focus != data->focus)
+  {
+    data->focus         = focus;
+    data->focus_time    = time;
+    data->is_prefetched = false;
+
+    return;
+  }
+
+  if (data->is_prefetched || (time - data->focus_time) < STOCKS_PREFETCH_DWELL)
+  {
+    return;
+  }
+
+  for (int offset = -STOCKS_PREFETCH_SPAN; offset <= STOCKS_PREFETCH_SPAN; offset++)
+  {
+    long index = (long) row + offset;
+
+    if (index < 0 || index >= (long) data->stock_count) continue;
+
+    // Neighbors that are scrolled out of the list are revalidated after the visible ones
+    stock_priority_t priority = tui_list_row_is_bound(list, index) ? STOCK_PRIORITY_VISIBLE : STOCK_PRIORITY_HIDDEN;
+
+    stock_t* stock = stocks_row_stock_get(data, index, priority);
+
+    if (!stock || stock == chart_stock) continue;
+
+    stock_prefetch(stock, "1d", (offset == 0) ? STOCK_PRIORITY_VISIBLE : STOCK_PRIORITY_PREFETCH);
+  }
+
+  data->is_prefetched = true;
+}
+
+/*
+ * Tick event, prefetch stocks and apply stock data that has arrived in the background
+ */
+bool stocks_tick(tui_t* tui)
+{
+  if (tui->menu)
+  {
+    tui_window_t* stocks_window = tui_menu_window_search(tui->menu, "root stocks");
+
+    tui_window_t* stock_window = tui_menu_window_search(tui->menu, "root stock");
+
+    stock_data_t* stock_data = stock_window ? stock_window->data : NULL;
+
+    if (stocks_window && stocks_window->data)
+    {
+      stocks_prefetch(stocks_window->data, stock_data ? stock_data->stock : NULL);
+    }
+  }
+
+  if (stock_poll(0) > 0)
+  {
+    // Updated stocks can be shown anywhere
+    tui_dirty_set(tui);
+
+    return true;
+  }
+
+  return false;
+}
+
 /*
  * Main function
  */
@@ -1610,10 +2491,88 @@ int main(int argc, char* argv[])
 
   debug_file_open(debug_file);
 
+  bool is_trace = false;
+
+  stock_network_t network = STOCK_NETWORK_LIVE;
+
+  int latency = 0;
+
+  char* url_base = NULL;
+
+  for (int index = 1; index < argc; index++)
+  {
+    if (strcmp(argv[index], "--trace") == 0)
+    {
+      is_trace = true;
+    }
+    else if (strcmp(argv[index], "--record") == 0)
+    {
+      network = STOCK_NETWORK_RECORD;
+    }
+    else if (strcmp(argv[index], "--replay") == 0)
+    {
+      network = STOCK_NETWORK_REPLAY;
+    }
+    else if (strcmp(argv[index], "--latency") == 0 && index + 1 < argc)
+    {
+      latency = atoi(argv[++index]);
+    }
+    else if (strcmp(argv[index], "--url") == 0 && index + 1 < argc)
+    {
+      url_base = argv[++index];
+    }
+    else
+    {
+      error_print("Unknown argument: %s", argv[index]);
+    }
+  }
+
+  char trace_file[64];
+
+  // The trace is only written when asked for, with --trace
+  if (is_trace &&
+      sprintf(trace_file, "%s/.stocks/trace.bin", getenv("HOME")) >= 0 &&
+      trace_file_open(trace_file) != 0)
+  {
+    error_print("Failed to open trace file: %s", trace_file);
+  }
+
+  if (url_base && stock_url_base_set(url_base) != 0)
+  {
+    error_print("Failed to set url: %s", url_base);
+  }
+
+  if (network != STOCK_NETWORK_LIVE)
+  {
+    char recording_dir[64];
+
+    sprintf(recording_dir, "%s/.stocks/recordings", getenv("HOME"));
+
+    mkdir(recording_dir, 0755);
+
+    if (stock_network_set(network, recording_dir, latency) != 0)
+    {
+      error_print("Failed to set network mode");
+    }
+  }
+
+  char profile_file[64];
+
+  if (sprintf(profile_file, "%s/.stocks/profile.csv", getenv("HOME")) < 0)
+  {
+    debug_file_close();
+
+    return 1;
+  }
+
   tui_t* tui = tui_create((tui_config_t)
   {
-    .event.key  = &tab_event,
-    .event.init = &tui_init,
+    .event.key    = &tab_event,
+    .event.tick   = &stocks_tick,
+    .event.init   = &tui_init,
+    .delay        = 100,
+    .fps          = 30,
+    .profile_file = profile_file,
   });
 
   if (!tui)
@@ -1629,6 +2588,18 @@ int main(int argc, char* argv[])
 
   tui_delete(&tui);
 
+  char stats_file[64];
+
+  if (sprintf(stats_file, "%s/.stocks/stats.txt", getenv("HOME")) >= 0 &&
+      stock_stats_dump(stats_file) != 0)
+  {
+    error_print("Failed to dump stats: %s", stats_file);
+  }
+
+  stock_quit();
+
+  trace_file_close();
+
   debug_file_close();
 
   return 0;
@@ -0,0 +1,180 @@
+/*
+ * trace.c - convert binary trace of stocks to Chrome trace-event JSON
+ *
+ * Written by Hampus Fridholm
+ *
+ * Usage: trace [trace file] [json file]
+ *
+ * The trace file defaults to ~/.stocks/trace.bin and the JSON is printed
+ * to stdout if no json file is given. Open the JSON in chrome://tracing
+ * or https://ui.perfetto.dev
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "debug.h"
+
+/*
+ * Print string as JSON string, escaping quotes and backslashes
+ */
+static void json_string_print(FILE* stream, const char* string)
+{
+  fputc('"', stream);
+
+  for (; *string; string++)
+  {
+    if (*string == '"' || *string == '\\')
+    {
+      fputc('\\', stream);
+    }
+
+    fputc(*string, stream);
+  }
+
+  fputc('"', stream);
+}
+
+/*
+ * Print trace record as trace event
+ *
+ * The time of the event is relative to the first record, in microseconds
+ */
+static void trace_record_print(FILE* stream, trace_record_t* record, uint64_t start, bool is_first)
+{
+  if (!is_first)
+  {
+    fprintf(stream, ",\n");
+  }
+
+  fprintf(stream, "  { \"name\": ");
+
+  json_string_print(stream, record->name);
+
+  fprintf(stream, ", \"cat\": \"stocks\", \"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": 1",
+    record->phase, (record->time - start) / 1000.0);
+
+  if (record->phase == 'b' || record->phase == 'e')
+  {
+    fprintf(stream, ", \"id\": \"0x%llx\"", (unsigned long long) record->id);
+  }
+
+  if (record->arg[0] != '\0')
+  {
+    fprintf(stream, ", \"args\": { \"arg\": ");
+
+    json_string_print(stream, record->arg);
+
+    fprintf(stream, " }");
+  }
+
+  fprintf(stream, " }");
+}
+
+/*
+ * Read trace file and print it's records as JSON, oldest first
+ */
+static int trace_convert(FILE* input, FILE* output)
+{
+  trace_header_t header;
+
+  if (fread(&header, sizeof(header), 1, input) != 1)
+  {
+    return 1;
+  }
+
+  if (memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != TRACE_VERSION ||
+      header.record_size != sizeof(trace_record_t))
+  {
+    return 2;
+  }
+
+  trace_record_t* records = malloc(sizeof(trace_record_t) * header.capacity);
+
+  if (!records)
+  {
+    return 3;
+  }
+
+  if (fread(records, sizeof(trace_record_t), header.capacity, input) != header.capacity)
+  {
+    free(records);
+
+    return 4;
+  }
+
+  // When the ring has wrapped, the oldest records are overwritten
+  uint64_t count = (header.count < header.capacity) ? header.count : header.capacity;
+
+  uint64_t first = header.count - count;
+
+  uint64_t start = (count > 0) ? records[first % header.capacity].time : 0;
+
+  fprintf(output, "{ \"traceEvents\": [\n");
+
+  for (uint64_t index = first; index < header.count; index++)
+  {
+    trace_record_print(output, &records[index % header.capacity], start, index == first);
+  }
+
+  fprintf(output, "\n] }\n");
+
+  free(records);
+
+  return 0;
+}
+
+/*
+ * Main function
+ */
+int main(int argc, char* argv[])
+{
+  char trace_file[256];
+
+  if (argc > 1)
+  {
+    snprintf(trace_file, sizeof(trace_file), "%s", argv[1]);
+  }
+  else
+  {
+    snprintf(trace_file, sizeof(trace_file), "%s/.stocks/trace.bin", getenv("HOME"));
+  }
+
+  FILE* input = fopen(trace_file, "rb");
+
+  if (!input)
+  {
+    fprintf(stderr, "trace: Failed to open %s\n", trace_file);
+
+    return 1;
+  }
+
+  FILE* output = (argc > 2) ? fopen(argv[2], "w") : stdout;
+
+  if (!output)
+  {
+    fprintf(stderr, "trace: Failed to open %s\n", argv[2]);
+
+    fclose(input);
+
+    return 2;
+  }
+
+  int status = trace_convert(input, output);
+
+  if (status != 0)
+  {
+    fprintf(stderr, "trace: Invalid trace file %s (%d)\n", trace_file, status);
+  }
+
+  fclose(input);
+
+  if (output != stdout)
+  {
+    fclose(output);
+  }
+
+  return (status == 0) ? 0 : 3;
+}
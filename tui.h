@@ -3,15 +3,19 @@
  *
  * Written by Hampus Fridholm
  *
- * Last updated: 2025-04-30
+ * Last updated: 2026-10-18
  */
 
 #ifndef TUI_H
 #define TUI_H
 
+#define NCURSES_WIDECHAR 1
+
 #include <ncurses.h>
+#include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <wchar.h>
 
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))
 #define MIN(a, b) (((a) > (b)) ? (b) : (a))
@@ -49,6 +53,7 @@ typedef struct tui_window_t tui_window_t;
  * enter  - on enter
  * exit   - on exit
  * update - before resize
+ * resize - after rect has changed, for content that depends on it
  * render - before render
  * key    - on keypress
  */
@@ -58,6 +63,7 @@ typedef struct tui_window_event_t
   void (*enter)  (tui_window_t* window);
   void (*exit)   (tui_window_t* window);
   void (*update) (tui_window_t* window);
+  void (*resize) (tui_window_t* window);
   void (*render) (tui_window_t* window);
   void (*free)   (tui_window_t* window);
   void (*init)   (tui_window_t* window);
@@ -76,10 +82,14 @@ typedef struct tui_menu_event_t
 
 /*
  * Tui event struct
+ *
+ * tick - every loop, at least every delay milliseconds,
+ *        return true if something changed and tui should be rendered
  */
 typedef struct tui_event_t
 {
   bool (*key)  (tui_t* tui, int key);
+  bool (*tick) (tui_t* tui);
   void (*init) (tui_t* tui);
 } tui_event_t;
 
@@ -168,12 +178,39 @@ typedef enum tui_window_type_t
   TUI_WINDOW_GRID,
 } tui_window_type_t;
 
+#define TUI_SEARCH_CACHE_SIZE 8
+
+/*
+ * Cached result of window search
+ *
+ * The result is only valid if the windows of tui
+ * have not changed since generation
+ */
+typedef struct tui_search_t
+{
+  char*         search;
+  uint64_t      hash;
+  tui_window_t* window;
+  size_t        generation;
+} tui_search_t;
+
 /*
  * Window struct
  *
  * is_contain window can't be the largest child in parent
  *
  * is_atomic window either contain all it's content or is invisable
+ *
+ * _is_dirty window must be rendered again, _is_child_dirty window has
+ * dirty windows somewhere among it's children
+ *
+ * _is_layout_dirty window might have changed size, so it's size must be
+ * calculated again, and so must the sizes of it's parents
+ *
+ * _clip is the part of the window that is inside all it's parents
+ * and the screen, which is where the window can draw cells
+ *
+ * _searches caches searches from the window, hashed by search string
  */
 typedef struct tui_window_t
 {
@@ -188,7 +225,12 @@ typedef struct tui_window_t
   bool                 h_grow;
   tui_rect_t           rect;
   tui_rect_t           _rect;  // Temp calculated rect
-  WINDOW*              window;
+  tui_rect_t           _last_rect; // Rect of last render
+  tui_rect_t           _size_rect; // Cached preliminary size
+  bool                 _is_dirty;
+  bool                 _is_child_dirty;
+  bool                 _is_layout_dirty;
+  tui_rect_t           _clip;  // Visable part of _rect on the screen
   tui_color_t          color;
   tui_color_t          _color; // Temp inherited color
   tui_window_event_t   event;
@@ -196,6 +238,7 @@ typedef struct tui_window_t
   tui_menu_t*          menu;
   tui_t*               tui;
   void*                data;   // User attached data
+  tui_search_t         _searches[TUI_SEARCH_CACHE_SIZE];
 } tui_window_t;
 
 /*
@@ -213,16 +256,38 @@ typedef struct tui_input_t
   tui_t*             tui;
 } tui_input_t;
 
+typedef struct tui_list_t tui_list_t;
+
+typedef tui_window_t* (*tui_list_item_create_t)(tui_list_t* list);
+
+typedef void (*tui_list_row_render_t)(tui_list_t* list, tui_window_t* item, size_t row);
+
+typedef void (*tui_list_row_release_t)(tui_list_t* list, tui_window_t* item, size_t row);
+
 /*
  * List data struct, that can be attached to window
+ *
+ * A virtual list (with row_render) has row_count rows, but only a pool
+ * of items, enough to fill the list. The items are bound to the rows
+ * from row_offset and onwards with row_render, as the list is scrolled.
+ * Rows that no item is bound to anymore are released with row_release
  */
 typedef struct tui_list_t
 {
-  tui_window_t** items;
-  size_t         item_count;
-  size_t         item_index;
-  bool           is_vertical;
-  tui_t*         tui;
+  tui_window_t**         items;
+  size_t                 item_count;
+  size_t                 item_index;
+  bool                   is_vertical;
+  size_t                 row_count;
+  size_t                 row_offset;  // Row of first item
+  tui_list_item_create_t item_create; // Create item for pool
+  tui_list_row_render_t  row_render;  // Bind item to row
+  tui_list_row_release_t row_release; // Unbind item from row
+  size_t                 pool_count;  // Items that fill the list
+  size_t                 _bind_offset;
+  size_t                 _bind_count;
+  void*                  data;        // User attached data
+  tui_t*                 tui;
 } tui_list_t;
 
 /*
@@ -250,15 +315,29 @@ typedef enum tui_align_t
 
 /*
  * Grid window square struct
+ *
+ * The symbol is a wide character, so that for example
+ * braille dots can be drawn with tui_window_grid_dot_set
  */
 typedef struct tui_window_grid_square_t
 {
   tui_color_t color;
-  char        symbol;
+  wchar_t     symbol;
 } tui_window_grid_square_t;
 
 /*
  * Grid window struct
+ *
+ * grid is the back buffer, which the squares of the next frame is drawn to
+ *
+ * _grid is the front buffer, which stores the squares of the last render,
+ * with inherited colors, so that only the changed squares have to be drawn
+ *
+ * layer is drawn over grid, like modifying the squares of grid, so that
+ * for example a cursor can be moved without drawing grid again
+ *
+ * Both buffers keep their capacity between frames,
+ * and are only reallocated when the grid grows
  */
 typedef struct tui_window_grid_t
 {
@@ -266,6 +345,10 @@ typedef struct tui_window_grid_t
   tui_size_t                size;
   tui_size_t                _size;
   tui_window_grid_square_t* grid;
+  tui_window_grid_square_t* _grid;
+  tui_window_grid_square_t* layer;
+  size_t                    _capacity;  // Squares allocated in each buffer
+  tui_rect_t                _grid_rect; // Rect of last render
 } tui_window_grid_t;
 
 /*
@@ -296,6 +379,8 @@ typedef struct tui_window_parent_t
   bool           has_gap;
   tui_pos_t      pos;
   tui_align_t    align;
+  tui_rect_t     _layout_rect; // Rect of last children layout
+  bool           _is_relayout; // Children layout must be calculated
 } tui_window_parent_t;
 
 /*
@@ -322,8 +407,65 @@ typedef struct tui_cursor_t
   int  y;
 } tui_cursor_t;
 
+/*
+ * Cell on the screen
+ *
+ * The cell either has a symbol (including ACS characters)
+ * or a wide character, which requires the locale to be set
+ */
+typedef struct tui_cell_t
+{
+  chtype      symbol;
+  wchar_t     wide;
+  tui_color_t color;
+} tui_cell_t;
+
+#define TUI_PROFILE_WINDOW_COUNT 5
+
+/*
+ * Render time of window, without the time of it's children
+ */
+typedef struct tui_profile_window_t
+{
+  char name[16];
+  long time;     // Microseconds
+} tui_profile_window_t;
+
+/*
+ * Timings of the stages of a frame, in microseconds
+ */
+typedef struct tui_profile_frame_t
+{
+  long                 update;
+  long                 resize;
+  long                 render;
+  long                 flush;
+  long                 total;
+  tui_profile_window_t windows[TUI_PROFILE_WINDOW_COUNT]; // Slowest windows first
+} tui_profile_frame_t;
+
+/*
+ * Frame profiling, shown in an overlay and written to a CSV file
+ *
+ * The overlay shows the last frame, while the current frame is measured
+ */
+typedef struct tui_profile_t
+{
+  bool                is_active;
+  char*               file_path;
+  FILE*               file;
+  size_t              count;   // Number of profiled frames
+  long                _nested; // Render time of the children of the current window
+  tui_profile_frame_t frame;
+  tui_profile_frame_t last;
+} tui_profile_t;
+
 /*
  * Tui struct
+ *
+ * Windows are drawn directly to _cells (back buffer), using their
+ * absolute rects, and only the cells that differ from _screen
+ * (front buffer) are flushed to the terminal
  */
 typedef struct tui_t
 {
@@ -337,7 +479,16 @@ typedef struct tui_t
   tui_color_t    color;
   tui_cursor_t   cursor;
   tui_event_t    event;
+  int            delay;  // Milliseconds between ticks
+  int            fps;    // Max renders per second, 0 is no limit
+  long           _render_time; // Milliseconds of last render
   bool           is_running;
+  bool           _is_dirty; // Every window must be rendered
+  size_t         _generation; // Changed when windows are added or removed
+  tui_cell_t*    _cells;
+  tui_cell_t*    _screen;
+  tui_size_t     _cells_size;
+  tui_profile_t  profile;
 } tui_t;
 
 #endif // TUI_H
@@ -348,9 +499,24 @@ typedef struct tui_t
 #include <errno.h>
 #include <string.h>
 #include <unistd.h>
+#include <time.h>
+#include <locale.h>
 
 #include "debug.h"
 
+/*
+ * Check if rects are equal, two none rects are equal
+ */
+static inline bool tui_rect_is_equal(tui_rect_t a, tui_rect_t b)
+{
+  if (a.is_none || b.is_none)
+  {
+    return a.is_none == b.is_none;
+  }
+
+  return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h;
+}
+
 /*
  * Get ncurses color index from tui color
  */
@@ -401,23 +567,229 @@ static inline tui_color_t tui_color_inherit(tui_t* tui, tui_window_t* window, tu
 }
 
 /*
- * Turn on color of window
+ * Get the part of rect that is inside clip
+ */
+static inline tui_rect_t tui_rect_clip(tui_rect_t rect, tui_rect_t clip)
+{
+  int x1 = MAX(rect.x, clip.x);
+  int y1 = MAX(rect.y, clip.y);
+
+  int x2 = MIN(rect.x + rect.w, clip.x + clip.w);
+  int y2 = MIN(rect.y + rect.h, clip.y + clip.h);
+
+  return (tui_rect_t)
+  {
+    .x = x1,
+    .y = y1,
+    .w = MAX(0, x2 - x1),
+    .h = MAX(0, y2 - y1)
+  };
+}
+
+/*
+ * Get rect of the whole screen
+ */
+static inline tui_rect_t tui_screen_rect_get(tui_t* tui)
+{
+  return (tui_rect_t)
+  {
+    .w = tui->_cells_size.w,
+    .h = tui->_cells_size.h
+  };
+}
+
+/*
+ * Check if cells look the same
+ */
+static inline bool tui_cell_is_equal(tui_cell_t a, tui_cell_t b)
+{
+  return a.symbol == b.symbol && a.wide == b.wide && a.color.fg == b.color.fg && a.color.bg == b.color.bg;
+}
+
+/*
+ * Resize the cell buffers to the size of the terminal
+ *
+ * The front buffer is zeroed, which no drawn cell is equal to,
+ * so every cell is flushed to the terminal again
+ */
+static inline int tui_cells_resize(tui_t* tui)
+{
+  size_t cell_count = tui->size.w * tui->size.h;
+
+  tui_cell_t* cells = realloc(tui->_cells, sizeof(tui_cell_t) * cell_count);
+
+  if (!cells)
+  {
+    return 1;
+  }
+
+  tui->_cells = cells;
+
+  tui_cell_t* screen = realloc(tui->_screen, sizeof(tui_cell_t) * cell_count);
+
+  if (!screen)
+  {
+    return 2;
+  }
+
+  tui->_screen = screen;
+
+  memset(tui->_cells, 0, sizeof(tui_cell_t) * cell_count);
+
+  memset(tui->_screen, 0, sizeof(tui_cell_t) * cell_count);
+
+  tui->_cells_size = tui->size;
+
+  return 0;
+}
+
+/*
+ * Get cell in back buffer, if it is inside clip
  */
-static inline void tui_ncurses_window_color_on(WINDOW* window, tui_color_t color)
+static inline tui_cell_t* tui_cell_get(tui_t* tui, tui_rect_t clip, int x, int y)
 {
-  wattron(window, COLOR_PAIR(tui_color_index_get(color)));
+  if (x < clip.x || x >= clip.x + clip.w ||
+      y < clip.y || y >= clip.y + clip.h)
+  {
+    return NULL;
+  }
+
+  return &tui->_cells[y * tui->_cells_size.w + x];
+}
+
+/*
+ * Set cell in back buffer, if it is inside clip
+ */
+static inline void tui_cell_set(tui_t* tui, tui_rect_t clip, int x, int y, chtype symbol, tui_color_t color)
+{
+  tui_cell_t* cell = tui_cell_get(tui, clip, x, y);
+
+  if (cell)
+  {
+    *cell = (tui_cell_t)
+    {
+      .symbol = symbol,
+      .color  = color
+    };
+  }
+}
+
+/*
+ * Set cell in back buffer to wide character, if it is inside clip
+ */
+static inline void tui_cell_wide_set(tui_t* tui, tui_rect_t clip, int x, int y, wchar_t wide, tui_color_t color)
+{
+  tui_cell_t* cell = tui_cell_get(tui, clip, x, y);
+
+  if (cell)
+  {
+    *cell = (tui_cell_t)
+    {
+      .wide  = wide,
+      .color = color
+    };
+  }
+}
+
+/*
+ * Fill the part of rect that is inside clip with spaces
+ */
+static inline void tui_cells_fill(tui_t* tui, tui_rect_t clip, tui_rect_t rect, tui_color_t color)
+{
+  rect = tui_rect_clip(rect, clip);
+
+  tui_cell_t cell = { .symbol = ' ', .color = color };
+
+  for (int y = rect.y; y < rect.y + rect.h; y++)
+  {
+    tui_cell_t* row = &tui->_cells[y * tui->_cells_size.w];
+
+    for (int x = rect.x; x < rect.x + rect.w; x++)
+    {
+      row[x] = cell;
+    }
+  }
 }
 
 /*
- * Turn off color of window
+ * Flush the cells that have changed since the last flush to the terminal
+ *
+ * Changed cells next to each other with the same color pair are flushed
+ * as one run, wide characters and narrow characters in separate runs.
+ * The color pair is part of the character, so pair 0 (default colors)
+ * replaces the last pair as well
  */
-static inline void tui_ncurses_window_color_off(WINDOW* window, tui_color_t color)
+static inline void tui_cells_flush(tui_t* tui)
 {
-  wattroff(window, COLOR_PAIR(tui_color_index_get(color)));
+  int w = tui->_cells_size.w;
+  int h = tui->_cells_size.h;
+
+  chtype  symbols[w + 1];
+  cchar_t wides[w + 1];
+
+  for (int y = 0; y < h; y++)
+  {
+    tui_cell_t* row    = &tui->_cells[y * w];
+    tui_cell_t* screen = &tui->_screen[y * w];
+
+    int x = 0;
+
+    while (x < w)
+    {
+      if (tui_cell_is_equal(row[x], screen[x]))
+      {
+        x++;
+
+        continue;
+      }
+
+      int start = x;
+
+      short pair = tui_color_index_get(row[x].color);
+
+      bool is_wide = (row[x].wide != L'\0');
+
+      int length = 0;
+
+      while (x < w && !tui_cell_is_equal(row[x], screen[x]) &&
+             (row[x].wide != L'\0') == is_wide && tui_color_index_get(row[x].color) == pair)
+      {
+        if (is_wide)
+        {
+          wchar_t string[] = { row[x].wide, L'\0' };
+
+          setcchar(&wides[length], string, A_NORMAL, pair, NULL);
+        }
+        else
+        {
+          symbols[length] = row[x].symbol | COLOR_PAIR(pair);
+        }
+
+        screen[x] = row[x];
+
+        length++;
+
+        x++;
+      }
+
+      if (is_wide)
+      {
+        mvadd_wchnstr(y, start, wides, length);
+      }
+      else
+      {
+        symbols[length] = 0;
+
+        mvaddchnstr(y, start, symbols, length);
+      }
+    }
+  }
 }
 
 /*
  * Draw window border with it's foreground color
+ *
+ * The lines are drawn before the corners, like ncurses box()
  */
 void tui_border_draw(tui_window_parent_t* window)
 {
@@ -432,11 +804,31 @@ void tui_border_draw(tui_window_parent_t* window)
 
   if (color.fg != TUI_COLOR_NONE || color.bg != TUI_COLOR_NONE)
   {
-    tui_ncurses_window_color_on(head->window, color);
+    tui_t* tui = head->tui;
+
+    tui_rect_t rect = head->_rect;
+
+    int x2 = rect.x + rect.w - 1;
+    int y2 = rect.y + rect.h - 1;
+
+    for (int x = rect.x + 1; x < x2; x++)
+    {
+      tui_cell_set(tui, head->_clip, x, rect.y, ACS_HLINE, color);
+
+      tui_cell_set(tui, head->_clip, x, y2, ACS_HLINE, color);
+    }
+
+    for (int y = rect.y + 1; y < y2; y++)
+    {
+      tui_cell_set(tui, head->_clip, rect.x, y, ACS_VLINE, color);
 
-    box(head->window, 0, 0);
+      tui_cell_set(tui, head->_clip, x2, y, ACS_VLINE, color);
+    }
 
-    tui_ncurses_window_color_off(head->window, color);
+    tui_cell_set(tui, head->_clip, rect.x, rect.y, ACS_ULCORNER, color);
+    tui_cell_set(tui, head->_clip, x2,     rect.y, ACS_URCORNER, color);
+    tui_cell_set(tui, head->_clip, rect.x, y2,     ACS_LLCORNER, color);
+    tui_cell_set(tui, head->_clip, x2,     y2,     ACS_LRCORNER, color);
   }
 }
 
@@ -466,6 +858,12 @@ void tui_ncurses_colors_init(void)
  */
 int tui_ncurses_init(void)
 {
+  // The locale is needed for wide characters,
+  // but numbers are still formatted the same way
+  setlocale(LC_ALL, "");
+
+  setlocale(LC_NUMERIC, "C");
+
   initscr();
   noecho();
   raw();
@@ -500,95 +898,6 @@ void tui_ncurses_quit(void)
   endwin();
 }
 
-/*
- * Create ncurses WINDOW* for tui_window_t
- */
-static inline WINDOW* tui_ncurses_window_create(tui_rect_t rect)
-{
-  // Can't create window with no size
-  if (rect.w == 0 || rect.h == 0)
-  {
-    return NULL;
-  }
-
-  WINDOW* window = newwin(rect.h, rect.w, rect.y, rect.x);
-
-  if (!window)
-  {
-    return NULL;
-  }
-
-  keypad(window, TRUE);
-
-  return window;
-}
-
-/*
- * Resize ncurses WINDOW*
- */
-static inline WINDOW* tui_ncurses_window_resize(WINDOW* window, tui_rect_t rect)
-{
-  // Don't resize window to no size
-  if (rect.w == 0 || rect.h == 0)
-  {
-    return window;
-  }
-
-  wresize(window, rect.h, rect.w);
-
-  mvwin(window, rect.y, rect.x);
-
-  return window;
-}
-
-/*
- * Update ncurses WINDOW*, either creating it or resizing it
- */
-static inline WINDOW* tui_ncurses_window_update(WINDOW* window, tui_rect_t rect)
-{
-  if (window)
-  {
-    return tui_ncurses_window_resize(window, rect);
-  }
-  else
-  {
-    return tui_ncurses_window_create(rect);
-  }
-}
-
-/*
- * Delete ncurses WINDOW*
- */
-static inline void tui_ncurses_window_free(WINDOW** window)
-{
-  if (!window || !(*window)) return;
-
-  // wclear(*window);
-
-  // wrefresh(*window);
-
-  delwin(*window);
-
-  *window = NULL;
-}
-
-/*
- * Fill ncurses WINDOW* with spaces
- */
-static inline void tui_ncurses_window_fill(WINDOW* window)
-{
-  int w = getmaxx(window);
-  int h = getmaxy(window);
-
-  for (int y = 0; y < h; y++)
-  {
-    for (int x = 0; x < w; x++)
-    {
-      mvwaddch(window, y, x, ' ');
-    }
-  }
-}
-
 /*
  * Configuration struct for creating tui
  */
@@ -596,6 +905,9 @@ typedef struct tui_config_t
 {
   tui_color_t color;
   tui_event_t event;
+  int         delay;
+  int         fps;
+  char*       profile_file; // CSV file of frame timings, written while profiling
 } tui_config_t;
 
 /*
@@ -624,9 +936,17 @@ tui_t* tui_create(tui_config_t config)
     .size.w = getmaxx(stdscr),
     .size.h = getmaxy(stdscr),
     .event  = config.event,
-    .color  = config.color
+    .color     = config.color,
+    .delay     = config.delay,
+    .fps       = config.fps,
+    ._is_dirty = true
   };
 
+  if (config.profile_file)
+  {
+    tui->profile.file_path = strdup(config.profile_file);
+  }
+
   if (tui->event.init)
   {
     tui->event.init(tui);
@@ -644,8 +964,6 @@ static inline void tui_window_parent_free(tui_window_parent_t** window)
 {
   tui_windows_free(&(*window)->children, &(*window)->child_count);
 
-  tui_ncurses_window_free(&(*window)->head.window);
-
   free(*window);
 
   *window = NULL;
@@ -656,8 +974,6 @@ static inline void tui_window_parent_free(tui_window_parent_t** window)
  */
 static inline void tui_window_text_free(tui_window_text_t** window)
 {
-  tui_ncurses_window_free(&(*window)->head.window);
-
   free((*window)->string);
 
   free((*window)->text);
@@ -672,10 +988,12 @@ static inline void tui_window_text_free(tui_window_text_t** window)
  */
 static inline void tui_window_grid_free(tui_window_grid_t** window)
 {
-  tui_ncurses_window_free(&(*window)->head.window);
-
   free((*window)->grid);
 
+  free((*window)->_grid);
+
+  free((*window)->layer);
+
   free(*window);
 
   *window = NULL;
@@ -693,6 +1011,14 @@ static inline void tui_window_free(tui_window_t** window)
     (*window)->event.free(*window);
   }
 
+  // Searches might have found this window
+  (*window)->tui->_generation++;
+
+  for (size_t index = 0; index < TUI_SEARCH_CACHE_SIZE; index++)
+  {
+    free((*window)->_searches[index].search);
+  }
+
   switch ((*window)->type)
   {
     case TUI_WINDOW_PARENT:
@@ -760,13 +1086,68 @@ void tui_delete(tui_t** tui)
 
   tui_windows_free(&(*tui)->windows, &(*tui)->window_count);
 
-  free(*tui);
+  free((*tui)->_cells);
 
-  *tui = NULL;
+  free((*tui)->_screen);
+
+  if ((*tui)->profile.file)
+  {
+    fclose((*tui)->profile.file);
+  }
+
+  free((*tui)->profile.file_path);
+
+  free(*tui);
+
+  *tui = NULL;
 
   tui_ncurses_quit();
 }
 
+/*
+ * Mark window as dirty, to be rendered again
+ *
+ * The parents are marked as having dirty children,
+ * so that only the damaged parts of the tree are visited
+ */
+void tui_window_dirty_set(tui_window_t* window)
+{
+  if (!window || window->_is_dirty) return;
+
+  window->_is_dirty = true;
+
+  tui_window_t* parent = (tui_window_t*) window->parent;
+
+  while (parent && !parent->_is_child_dirty)
+  {
+    parent->_is_child_dirty = true;
+
+    parent = (tui_window_t*) parent->parent;
+  }
+}
+
+/*
+ * Mark window as layout dirty, to calculate it's size again
+ *
+ * This must be done when the size or visability of window might change,
+ * for example when changing is_hidden or rect of the window
+ */
+void tui_window_layout_dirty_set(tui_window_t* window)
+{
+  for (; window; window = (tui_window_t*) window->parent)
+  {
+    window->_is_layout_dirty = true;
+  }
+}
+
+/*
+ * Mark the whole tui as dirty, every window will be rendered again
+ */
+void tui_dirty_set(tui_t* tui)
+{
+  tui->_is_dirty = true;
+}
+
 /*
  * Trigger tui event
  *
@@ -784,6 +1165,8 @@ bool tui_event(tui_t* tui, int key)
   {
     if (window->event.key && window->event.key(window, key))
     {
+      tui_window_dirty_set(window);
+
       return true;
     }
 
@@ -794,11 +1177,15 @@ bool tui_event(tui_t* tui, int key)
 
   if (menu && menu->event.key && menu->event.key(menu, key))
   {
+    tui_dirty_set(tui);
+
     return true;
   }
 
   if (tui->event.key && tui->event.key(tui, key))
   {
+    tui_dirty_set(tui);
+
     return true;
   }
 
@@ -1004,10 +1391,6 @@ static inline void tui_string_ansi_handle(tui_window_t* window, char* ansi, int
   if (code == 0)
   {
     *color = window->_color;
-
-    wattroff(window->window, A_ATTRIBUTES);
-
-    tui_ncurses_window_color_on(window->window, window->_color);
   }
   // Cursor on
   else if (code == 5)
@@ -1022,15 +1405,11 @@ static inline void tui_string_ansi_handle(tui_window_t* window, char* ansi, int
   else if (code >= 30 && code <= 37)
   {
     color->fg = code - 30;
-
-    tui_ncurses_window_color_on(window->window, *color);
   }
   // Background color
   else if (code >= 40 && code <= 47)
   {
     color->bg = code - 40;
-
-    tui_ncurses_window_color_on(window->window, *color);
   }
 }
 
@@ -1099,7 +1478,7 @@ static inline void tui_text_render(tui_window_text_t* window)
           letter = '*';
         }
 
-        mvwaddch(head->window, y_shift + y, x_shift + x, letter);
+        tui_cell_set(head->tui, head->_clip, rect.x + x_shift + x, rect.y + y_shift + y, (unsigned char) letter, color);
       }
 
       x++;
@@ -1156,17 +1535,11 @@ static inline void tui_window_text_render(tui_window_text_t* window)
 {
   tui_window_t* head = &window->head;
 
-  WINDOW* parent = head->parent ? head->parent->head.window : stdscr;
-
-  overwrite(parent, head->window);
-
   head->_color = tui_color_inherit(head->tui, (tui_window_t*) head->parent, head->color);
 
-  tui_ncurses_window_color_on(head->window, head->_color);
-
   if (head->color.bg != TUI_COLOR_NONE)
   {
-    tui_ncurses_window_fill(head->window);
+    tui_cells_fill(head->tui, head->_clip, head->_rect, head->_color);
   }
 
   // Draw text
@@ -1174,28 +1547,108 @@ static inline void tui_window_text_render(tui_window_text_t* window)
   {
     tui_text_render(window);
   }
+}
+
+/*
+ * Modify square by changing symbol or color if specified
+ */
+static inline void tui_grid_square_modify(tui_window_grid_square_t* square, tui_window_grid_square_t modify)
+{
+  if (modify.color.fg != TUI_COLOR_NONE)
+  {
+    square->color.fg = modify.color.fg;
+  }
+
+  if (modify.color.bg != TUI_COLOR_NONE)
+  {
+    square->color.bg = modify.color.bg;
+  }
+
+  if (modify.symbol)
+  {
+    square->symbol = modify.symbol;
+  }
+}
+
+/*
+ * Check if grid squares look the same
+ */
+static inline bool tui_window_grid_square_is_equal(tui_window_grid_square_t a, tui_window_grid_square_t b)
+{
+  return a.symbol == b.symbol && a.color.fg == b.color.fg && a.color.bg == b.color.bg;
+}
+
+/*
+ * Draw row of grid squares
+ *
+ * If last is specified, squares equal to the last squares are skipped
+ */
+static inline void tui_window_grid_row_draw(tui_window_grid_t* window, tui_window_grid_square_t* row, tui_window_grid_square_t* last, int x_shift, int y)
+{
+  tui_window_t* head = &window->head;
+
+  for (int x = 0; x < window->_size.w; x++)
+  {
+    if (last && tui_window_grid_square_is_equal(row[x], last[x])) continue;
+
+    int cell_x = head->_rect.x + x_shift + x;
+
+    int cell_y = head->_rect.y + y;
+
+    if (row[x].symbol > 0x7f)
+    {
+      tui_cell_wide_set(head->tui, head->_clip, cell_x, cell_y, row[x].symbol, row[x].color);
+    }
+    else
+    {
+      tui_cell_set(head->tui, head->_clip, cell_x, cell_y, row[x].symbol, row[x].color);
+    }
+  }
+}
 
-  overwrite(head->window, parent);
+/*
+ * Check if the grid covers the whole window
+ */
+static inline bool tui_window_grid_is_cover(tui_window_grid_t* window)
+{
+  return window->grid &&
+    window->_size.w == window->head._rect.w &&
+    window->_size.h == window->head._rect.h;
 }
 
+static inline bool tui_window_is_redrawn(tui_window_t* window);
+
 /*
  * Render grid window
+ *
+ * If the grid covers the whole window, and no parent has drawn over it,
+ * the cells of the window are kept between renders,
+ * and only the squares that have changed are drawn
  */
 static inline void tui_window_grid_render(tui_window_grid_t* window)
 {
   tui_window_t* head = &window->head;
 
-  WINDOW* parent = head->parent ? head->parent->head.window : stdscr;
+  head->_color = tui_color_inherit(head->tui, (tui_window_t*) head->parent, head->color);
 
-  overwrite(parent, head->window);
+  bool is_cover = tui_window_grid_is_cover(window);
 
-  head->_color = tui_color_inherit(head->tui, (tui_window_t*) head->parent, head->color);
+  bool is_diff = is_cover && !head->tui->_is_dirty &&
+    !tui_window_is_redrawn((tui_window_t*) head->parent) &&
+    tui_rect_is_equal(window->_grid_rect, head->_rect);
 
-  tui_ncurses_window_color_on(head->window, head->_color);
+  if (!is_cover)
+  {
+    if (head->color.bg != TUI_COLOR_NONE)
+    {
+      tui_cells_fill(head->tui, head->_clip, head->_rect, head->_color);
+    }
 
-  if (head->color.bg != TUI_COLOR_NONE)
+    window->_grid_rect = TUI_RECT_NONE;
+  }
+  else
   {
-    tui_ncurses_window_fill(head->window);
+    window->_grid_rect = head->_rect;
   }
 
   // Draw grid
@@ -1204,28 +1657,88 @@ static inline void tui_window_grid_render(tui_window_grid_t* window)
     int x_shift = MAX(0, (head->_rect.w - window->_size.w) / 2.f);
     int y_shift = MAX(0, (head->_rect.h - window->_size.h) / 2.f);
 
+    tui_window_grid_square_t row[window->_size.w];
+
     for (int y = 0; y < window->_size.h; y++)
     {
       for (int x = 0; x < window->_size.w; x++)
       {
-        int index = y * window->_size.w + x;
+        tui_window_grid_square_t square = window->grid[y * window->_size.w + x];
 
-        tui_window_grid_square_t square = window->grid[index];
+        tui_grid_square_modify(&square, window->layer[y * window->_size.w + x]);
 
-        char symbol = square.symbol ? square.symbol : ' ';
-
-        tui_color_t color = tui_color_inherit(head->tui, (tui_window_t*) window, square.color);
+        row[x] = (tui_window_grid_square_t)
+        {
+          .symbol = square.symbol ? square.symbol : ' ',
+          .color  = tui_color_inherit(head->tui, (tui_window_t*) window, square.color),
+        };
+      }
 
-        tui_ncurses_window_color_on(head->window, color);
+      tui_window_grid_square_t* last = is_diff ? &window->_grid[y * window->_size.w] : NULL;
 
-        mvwaddch(head->window, y_shift + y, x_shift + x, symbol);
+      tui_window_grid_row_draw(window, row, last, x_shift, y_shift + y);
 
-        tui_ncurses_window_color_off(head->window, color);
+      if (is_cover)
+      {
+        memcpy(&window->_grid[y * window->_size.w], row, sizeof(row));
       }
     }
   }
+}
+
+/*
+ * Get monotonic time in microseconds, if the tui is profiled
+ */
+static inline long tui_profile_time_get(tui_t* tui)
+{
+  if (!tui->profile.is_active) return 0;
+
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return (time.tv_sec * 1000000) + (time.tv_nsec / 1000);
+}
+
+/*
+ * Store the time since start in stage, and restart the time
+ */
+static inline void tui_profile_stage_end(tui_t* tui, long* stage, long* start)
+{
+  if (!tui->profile.is_active) return;
+
+  long time = tui_profile_time_get(tui);
+
+  *stage = time - *start;
+
+  *start = time;
+}
+
+/*
+ * Add window to the slowest windows of the frame, if it is slow enough
+ */
+static inline void tui_profile_window_add(tui_t* tui, tui_window_t* window, long time)
+{
+  tui_profile_window_t* windows = tui->profile.frame.windows;
+
+  size_t index = TUI_PROFILE_WINDOW_COUNT;
+
+  while (index > 0 && time > windows[index - 1].time)
+  {
+    index--;
+  }
+
+  if (index >= TUI_PROFILE_WINDOW_COUNT) return;
+
+  memmove(&windows[index + 1], &windows[index], sizeof(tui_profile_window_t) * (TUI_PROFILE_WINDOW_COUNT - 1 - index));
+
+  char* types[] = { "parent", "text", "grid" };
+
+  char* name = window->name ? window->name : types[window->type];
+
+  windows[index].time = time;
 
-  overwrite(head->window, parent);
+  snprintf(windows[index].name, sizeof(windows[index].name), "%s", name);
 }
 
 static inline void tui_window_render(tui_window_t* window);
@@ -1237,17 +1750,11 @@ static inline void tui_window_parent_render(tui_window_parent_t* window)
 {
   tui_window_t* head = &window->head;
 
-  WINDOW* parent = head->parent ? head->parent->head.window : stdscr;
-
-  overwrite(parent, head->window);
-
   head->_color = tui_color_inherit(head->tui, (tui_window_t*) head->parent, head->color);
 
-  tui_ncurses_window_color_on(head->window, head->_color);
-
   if (head->color.bg != TUI_COLOR_NONE)
   {
-    tui_ncurses_window_fill(head->window);
+    tui_cells_fill(head->tui, head->_clip, head->_rect, head->_color);
   }
 
   // Draw border
@@ -1263,15 +1770,27 @@ static inline void tui_window_parent_render(tui_window_parent_t* window)
       tui_window_render(child);
     }
   }
-  
-  overwrite(head->window, parent);
 }
 
 /*
  * Render window
+ *
+ * The window is clipped to the visable part of it's parent
  */
 static inline void tui_window_render(tui_window_t* window)
 {
+  tui_profile_t* profile = &window->tui->profile;
+
+  long start = tui_profile_time_get(window->tui);
+
+  long nested = profile->_nested;
+
+  profile->_nested = 0;
+
+  tui_rect_t clip = window->parent ? window->parent->head._clip : tui_screen_rect_get(window->tui);
+
+  window->_clip = tui_rect_clip(window->_rect, clip);
+
   if (window->event.render)
   {
     window->event.render(window);
@@ -1294,6 +1813,15 @@ static inline void tui_window_render(tui_window_t* window)
     default:
       break;
   }
+
+  if (profile->is_active)
+  {
+    long time = tui_profile_time_get(window->tui) - start;
+
+    tui_profile_window_add(window->tui, window, time - profile->_nested);
+
+    profile->_nested = nested + time;
+  }
 }
 
 /*
@@ -1417,6 +1945,9 @@ static inline void tui_window_parent_size_calc(tui_window_parent_t* parent)
     {
       tui_window_t* child = parent->children[index];
 
+      // Hidden windows take up no space
+      if (child->is_hidden) continue;
+
       if (!child->is_contain)
       {
         max_size.w = MAX(max_size.w, child->_rect.w);
@@ -1488,13 +2019,25 @@ static inline void tui_window_parent_size_calc(tui_window_parent_t* parent)
  * Calculate preliminary size of window, based on content
  *
  * Size is temporarily stored in _rect
+ *
+ * The size is cached in _size_rect, and only calculated again
+ * if the window is layout dirty
  */
 static inline void tui_window_size_calc(tui_window_t* window)
 {
+  if (!window->_is_layout_dirty)
+  {
+    window->_rect = window->_size_rect;
+
+    return;
+  }
+
   switch (window->type)
   {
     case TUI_WINDOW_PARENT:
       tui_window_parent_size_calc((tui_window_parent_t*) window);
+
+      ((tui_window_parent_t*) window)->_is_relayout = true;
       break;
 
     case TUI_WINDOW_TEXT:
@@ -1508,6 +2051,10 @@ static inline void tui_window_size_calc(tui_window_t* window)
     default:
       break;
   }
+
+  window->_size_rect = window->_rect;
+
+  window->_is_layout_dirty = false;
 }
 
 /*
@@ -1899,6 +2446,9 @@ static inline void tui_window_set_invisable(tui_window_t* window)
     {
       tui_window_parent_t* parent = (tui_window_parent_t*) window;
 
+      // The children must be layed out again when the window is visable
+      parent->_layout_rect = TUI_RECT_NONE;
+
       for (size_t index = 0; index < parent->child_count; index++)
       {
         tui_window_t* child = parent->children[index];
@@ -1938,10 +2488,29 @@ static inline tui_size_t tui_max_size_get(tui_window_parent_t* parent)
 /*
  * Calculate rect of parent's children
  *
- * Make use of the temporarily stored sizes in _rect
+ * Make use of the cached preliminary sizes in _size_rect
+ *
+ * If no child has changed size and the parent has the same rect,
+ * the children have the same rects as last time
  */
 static inline void tui_children_rect_calc(tui_window_parent_t* parent)
 {
+  if (!parent->_is_relayout && tui_rect_is_equal(parent->head._rect, parent->_layout_rect))
+  {
+    return;
+  }
+
+  parent->_is_relayout = false;
+
+  parent->_layout_rect = parent->head._rect;
+
+  for (size_t index = 0; index < parent->child_count; index++)
+  {
+    tui_window_t* child = parent->children[index];
+
+    child->_rect = child->_size_rect;
+  }
+
   tui_size_t max_size = tui_max_size_get(parent);
 
   tui_size_t align_size = { 0 };
@@ -2057,8 +2626,6 @@ static inline void tui_children_rect_calc(tui_window_parent_t* parent)
       child->_rect.x += parent->head._rect.x;
       child->_rect.y += parent->head._rect.y;
 
-      child->window = tui_ncurses_window_update(child->window, child->_rect);
-
       if (child->type == TUI_WINDOW_PARENT)
       {
         tui_children_rect_calc((tui_window_parent_t*) child);
@@ -2095,8 +2662,6 @@ static inline void tui_window_rect_calc(tui_window_t* window, int w, int h)
   {
     window->_is_visable = true;
 
-    window->window = tui_ncurses_window_update(window->window, window->_rect);
-
     if(window->type == TUI_WINDOW_PARENT)
     {
       tui_children_rect_calc((tui_window_parent_t*) window);
@@ -2151,12 +2716,50 @@ static inline void tui_size_calc(tui_t* tui)
 }
 
 /*
- * Resize tui by recalculating every size and rect of windows
+ * Mark windows and all their children as layout dirty
+ */
+static inline void tui_windows_layout_dirty_set(tui_window_t** windows, size_t count)
+{
+  for (size_t index = 0; index < count; index++)
+  {
+    tui_window_t* window = windows[index];
+
+    window->_is_layout_dirty = true;
+
+    if (window->type == TUI_WINDOW_PARENT)
+    {
+      tui_window_parent_t* parent = (tui_window_parent_t*) window;
+
+      tui_windows_layout_dirty_set(parent->children, parent->child_count);
+    }
+  }
+}
+
+/*
+ * Resize tui by recalculating sizes and rects of windows
+ *
+ * Only windows that have changed are calculated again,
+ * unless the size of the terminal has changed
  */
 static inline void tui_resize(tui_t* tui)
 {
-  tui->size.w = getmaxx(stdscr);
-  tui->size.h = getmaxy(stdscr);
+  int w = getmaxx(stdscr);
+  int h = getmaxy(stdscr);
+
+  if (tui->size.w != w || tui->size.h != h)
+  {
+    tui->size.w = w;
+    tui->size.h = h;
+
+    tui_windows_layout_dirty_set(tui->windows, tui->window_count);
+
+    for (size_t index = 0; index < tui->menu_count; index++)
+    {
+      tui_menu_t* menu = tui->menus[index];
+
+      tui_windows_layout_dirty_set(menu->windows, menu->window_count);
+    }
+  }
 
   tui_size_calc(tui);
 
@@ -2202,67 +2805,681 @@ static inline void tui_update(tui_t* tui)
 }
 
 /*
- * Render tui - active menu and all windows
+ * Check if window is damaged, either itself or some of it's children
  */
-void tui_render(tui_t* tui)
+static inline bool tui_window_is_damaged(tui_window_t* window)
 {
-  tui->cursor.is_active = false;
-
-  curs_set(0);
-
-  tui_update(tui);
+  return window->_is_dirty || window->_is_child_dirty;
+}
 
-  tui_resize(tui);
+/*
+ * Check if any of the windows is damaged
+ */
+static inline bool tui_windows_is_damaged(tui_window_t** windows, size_t count)
+{
+  for (size_t index = 0; index < count; index++)
+  {
+    if (tui_window_is_damaged(windows[index]))
+    {
+      return true;
+    }
+  }
 
-  tui_menu_t* menu = tui->menu;
+  return false;
+}
 
-  if (menu)
+/*
+ * Check if tui has anything to render
+ */
+static inline bool tui_is_damaged(tui_t* tui)
+{
+  if (tui->_is_dirty)
   {
-    menu->_color = tui_color_inherit(menu->tui, NULL, menu->color);
-
-    tui_ncurses_window_color_on(stdscr, menu->_color);
+    return true;
   }
-  else
+
+  if (tui_windows_is_damaged(tui->windows, tui->window_count))
   {
-    tui_ncurses_window_color_on(stdscr, tui->color);
+    return true;
   }
 
-  tui_ncurses_window_fill(stdscr);
+  tui_menu_t* menu = tui->menu;
 
-  // 3. Render tui windows
-  tui_windows_render(tui->windows, tui->window_count);
+  return menu && tui_windows_is_damaged(menu->windows, menu->window_count);
+}
 
-  // 4. Render menu windows
-  if (menu)
+/*
+ * Update (change content) dirty windows and children of dirty windows
+ */
+static inline void tui_windows_damage_update(tui_window_t** windows, size_t count)
+{
+  for (size_t index = 0; index < count; index++)
   {
-    tui_windows_render(menu->windows, menu->window_count);
-  }
-
-  tui_cursor_t cursor = tui->cursor;
+    tui_window_t* window = windows[index];
 
-  if (cursor.is_active)
-  {
-    if (cursor.y >= 0 && cursor.y < tui->size.h &&
-        cursor.x >= 0 && cursor.x < tui->size.w)
+    if (window->_is_dirty)
     {
-      move(cursor.y, cursor.x);
+      tui_windows_update(&window, 1);
+    }
+    else if (window->_is_child_dirty)
+    {
+      tui_window_parent_t* parent = (tui_window_parent_t*) window;
 
-      curs_set(1);
+      tui_windows_damage_update(parent->children, parent->child_count);
     }
   }
 }
 
 /*
- * Configuration struct for parent window
+ * Check if rects overlap each other
  */
-typedef struct tui_window_parent_config_t
+static inline bool tui_rect_is_overlap(tui_rect_t a, tui_rect_t b)
 {
-  char*              name;
-  tui_window_event_t event;
-  tui_rect_t         rect;
-  bool               w_grow;
-  bool               h_grow;
-  tui_color_t        color;
+  return a.x < b.x + b.w && b.x < a.x + a.w &&
+         a.y < b.y + b.h && b.y < a.y + a.h;
+}
+
+/*
+ * Check if rect is inside other rect
+ */
+static inline bool tui_rect_is_inside(tui_rect_t rect, tui_rect_t outer)
+{
+  return rect.x >= outer.x && rect.x + rect.w <= outer.x + outer.w &&
+         rect.y >= outer.y && rect.y + rect.h <= outer.y + outer.h;
+}
+
+/*
+ * Mark windows whose rect or visability has changed since the last render
+ *
+ * The parent is marked, because the old area of the window must be cleared.
+ * The resize event is called, for windows whose content depends on their rect
+ */
+static inline void tui_windows_rect_damage_calc(tui_t* tui, tui_window_t** windows, size_t count)
+{
+  for (size_t index = 0; index < count; index++)
+  {
+    tui_window_t* window = windows[index];
+
+    tui_rect_t rect = window->_is_visable ? window->_rect : TUI_RECT_NONE;
+
+    if (!tui_rect_is_equal(rect, window->_last_rect))
+    {
+      window->_last_rect = rect;
+
+      if (window->parent)
+      {
+        tui_window_dirty_set((tui_window_t*) window->parent);
+      }
+      else
+      {
+        tui_dirty_set(tui);
+      }
+
+      if (window->_is_visable && window->event.resize)
+      {
+        window->event.resize(window);
+      }
+    }
+
+    if (window->type == TUI_WINDOW_PARENT)
+    {
+      tui_window_parent_t* parent = (tui_window_parent_t*) window;
+
+      tui_windows_rect_damage_calc(tui, parent->children, parent->child_count);
+    }
+  }
+}
+
+/*
+ * Check if any of the windows is layout dirty
+ *
+ * Layout dirty is set all the way up to the root windows,
+ * so only the root windows have to be checked
+ */
+static inline bool tui_windows_is_layout_dirty(tui_window_t** windows, size_t count)
+{
+  for (size_t index = 0; index < count; index++)
+  {
+    if (windows[index]->_is_layout_dirty) return true;
+  }
+
+  return false;
+}
+
+/*
+ * Mark tui windows whose rect or visability has changed since the last render
+ *
+ * RETURN (bool is_layout_dirty)
+ * - true  | a resize event changed the layout, which must be calculated again
+ * - false | the layout is done
+ */
+static inline bool tui_rect_damage_calc(tui_t* tui)
+{
+  tui_windows_rect_damage_calc(tui, tui->windows, tui->window_count);
+
+  tui_menu_t* menu = tui->menu;
+
+  if (menu)
+  {
+    tui_windows_rect_damage_calc(tui, menu->windows, menu->window_count);
+  }
+
+  return tui_windows_is_layout_dirty(tui->windows, tui->window_count) ||
+         (menu && tui_windows_is_layout_dirty(menu->windows, menu->window_count));
+}
+
+/*
+ * Check if damaged window overlaps any other visable window
+ */
+static inline bool tui_windows_damage_is_overlap(tui_window_t** windows, size_t count, tui_window_t* window)
+{
+  for (size_t index = 0; index < count; index++)
+  {
+    tui_window_t* other = windows[index];
+
+    if (other != window && other->_is_visable &&
+        tui_rect_is_overlap(window->_rect, other->_rect))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+ * Escalate damage of children to parent
+ *
+ * A damaged child that overlaps a sibling or the border of it's parent
+ * can't be rendered alone, so the whole parent is rendered instead
+ */
+static inline void tui_window_damage_escalate(tui_window_t* window)
+{
+  if (window->type != TUI_WINDOW_PARENT || window->_is_dirty || !window->_is_child_dirty)
+  {
+    return;
+  }
+
+  tui_window_parent_t* parent = (tui_window_parent_t*) window;
+
+  for (size_t index = 0; index < parent->child_count; index++)
+  {
+    tui_window_damage_escalate(parent->children[index]);
+  }
+
+  tui_rect_t inner = window->_rect;
+
+  if (parent->border.is_active)
+  {
+    inner = (tui_rect_t)
+    {
+      .x = inner.x + 1,
+      .y = inner.y + 1,
+      .w = inner.w - 2,
+      .h = inner.h - 2
+    };
+  }
+
+  for (size_t index = 0; index < parent->child_count; index++)
+  {
+    tui_window_t* child = parent->children[index];
+
+    if (!child->_is_visable || !tui_window_is_damaged(child)) continue;
+
+    if (!tui_rect_is_inside(child->_rect, inner) ||
+        tui_windows_damage_is_overlap(parent->children, parent->child_count, child))
+    {
+      window->_is_dirty = true;
+
+      break;
+    }
+  }
+}
+
+/*
+ * Escalate damage of windows, return true if every window must be rendered
+ */
+static inline bool tui_windows_damage_escalate(tui_window_t** windows, size_t count)
+{
+  for (size_t index = 0; index < count; index++)
+  {
+    tui_window_t* window = windows[index];
+
+    tui_window_damage_escalate(window);
+
+    if (!window->_is_visable || !tui_window_is_damaged(window)) continue;
+
+    // Base windows can't be cleared, and might overlap each other
+    if (window->_is_dirty || tui_windows_damage_is_overlap(windows, count, window))
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+ * Check if window or any of it's parents is dirty
+ */
+static inline bool tui_window_is_redrawn(tui_window_t* window)
+{
+  for (; window; window = (tui_window_t*) window->parent)
+  {
+    if (window->_is_dirty)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*
+ * Clear the area of window in it's parent window
+ */
+static inline void tui_window_clear(tui_window_t* window)
+{
+  tui_window_parent_t* parent = window->parent;
+
+  if (!parent) return;
+
+  // A grid that covers it's window draws over every cell anyway
+  if (window->type == TUI_WINDOW_GRID &&
+      tui_window_grid_is_cover((tui_window_grid_t*) window))
+  {
+    return;
+  }
+
+  tui_cells_fill(window->tui, parent->head._clip, window->_rect, parent->head._color);
+}
+
+/*
+ * Render only the damaged windows
+ *
+ * A dirty window is rendered with all it's children, over a cleared area,
+ * while only the damaged children of a window with dirty children are rendered
+ */
+static inline void tui_windows_damage_render(tui_window_t** windows, size_t count)
+{
+  for (size_t index = 0; index < count; index++)
+  {
+    tui_window_t* window = windows[index];
+
+    if (!window->_is_visable) continue;
+
+    if (window->_is_dirty)
+    {
+      tui_window_clear(window);
+
+      tui_window_render(window);
+    }
+    else if (window->_is_child_dirty)
+    {
+      tui_window_parent_t* parent = (tui_window_parent_t*) window;
+
+      tui_windows_damage_render(parent->children, parent->child_count);
+    }
+  }
+}
+
+/*
+ * Clear dirty flags of windows
+ */
+static inline void tui_windows_clean(tui_window_t** windows, size_t count, bool is_all)
+{
+  for (size_t index = 0; index < count; index++)
+  {
+    tui_window_t* window = windows[index];
+
+    if (!is_all && !tui_window_is_damaged(window)) continue;
+
+    window->_is_dirty       = false;
+    window->_is_child_dirty = false;
+
+    if (window->type == TUI_WINDOW_PARENT)
+    {
+      tui_window_parent_t* parent = (tui_window_parent_t*) window;
+
+      tui_windows_clean(parent->children, parent->child_count, is_all);
+    }
+  }
+}
+
+/*
+ * Render every tui window - active menu and all windows
+ */
+static inline void tui_full_render(tui_t* tui)
+{
+  tui->cursor.is_active = false;
+
+  tui_menu_t* menu = tui->menu;
+
+  tui_color_t color = tui->color;
+
+  if (menu)
+  {
+    menu->_color = tui_color_inherit(menu->tui, NULL, menu->color);
+
+    color = menu->_color;
+  }
+
+  tui_rect_t screen = tui_screen_rect_get(tui);
+
+  tui_cells_fill(tui, screen, screen, color);
+
+  // 3. Render tui windows
+  tui_windows_render(tui->windows, tui->window_count);
+
+  // 4. Render menu windows
+  if (menu)
+  {
+    tui_windows_render(menu->windows, menu->window_count);
+  }
+}
+
+/*
+ * Draw line of profile overlay in the top right corner
+ */
+static inline void tui_profile_line_draw(tui_t* tui, int y, const char* line)
+{
+  tui_rect_t screen = tui_screen_rect_get(tui);
+
+  tui_color_t color = { .fg = TUI_COLOR_WHITE, .bg = TUI_COLOR_BLACK };
+
+  int w = 28;
+
+  int x = tui->_cells_size.w - w;
+
+  int length = strlen(line);
+
+  for (int index = 0; index < w; index++)
+  {
+    char symbol = (index < length) ? line[index] : ' ';
+
+    tui_cell_set(tui, screen, x + index, y, (unsigned char) symbol, color);
+  }
+}
+
+/*
+ * Draw profile overlay with the timings of the last frame
+ */
+static inline void tui_profile_draw(tui_t* tui)
+{
+  tui_profile_frame_t* last = &tui->profile.last;
+
+  struct { char* name; long time; } stages[] =
+  {
+    { "update", last->update },
+    { "resize", last->resize },
+    { "render", last->render },
+    { "flush",  last->flush  },
+    { "total",  last->total  },
+  };
+
+  char line[64];
+
+  int y = 0;
+
+  snprintf(line, sizeof(line), " Frame %zu", tui->profile.count);
+
+  tui_profile_line_draw(tui, y++, line);
+
+  for (size_t index = 0; index < 5; index++)
+  {
+    snprintf(line, sizeof(line), " %-16s %6.3f ms", stages[index].name, stages[index].time / 1000.f);
+
+    tui_profile_line_draw(tui, y++, line);
+  }
+
+  tui_profile_line_draw(tui, y++, " Slowest windows");
+
+  // Every line is drawn, so the windows of an earlier frame don't linger
+  for (size_t index = 0; index < TUI_PROFILE_WINDOW_COUNT; index++)
+  {
+    tui_profile_window_t window = last->windows[index];
+
+    if (window.time > 0)
+    {
+      snprintf(line, sizeof(line), " %-16s %6.3f ms", window.name, window.time / 1000.f);
+    }
+    else
+    {
+      line[0] = '\0';
+    }
+
+    tui_profile_line_draw(tui, y++, line);
+  }
+}
+
+/*
+ * End profiled frame, by writing it to the CSV file
+ * and keeping it to be shown in the overlay
+ */
+static inline void tui_profile_frame_end(tui_t* tui)
+{
+  tui_profile_t* profile = &tui->profile;
+
+  if (!profile->is_active) return;
+
+  tui_profile_frame_t frame = profile->frame;
+
+  if (profile->file)
+  {
+    fprintf(profile->file, "%zu,%ld,%ld,%ld,%ld,%ld,%s,%ld\n",
+      profile->count, frame.update, frame.resize, frame.render, frame.flush, frame.total,
+      frame.windows[0].name, frame.windows[0].time);
+  }
+
+  profile->last = frame;
+
+  profile->count++;
+
+  memset(&profile->frame, 0, sizeof(tui_profile_frame_t));
+}
+
+#define TUI_LAYOUT_PASS_COUNT 3
+
+/*
+ * Render tui, but only the damaged windows
+ *
+ * If nothing has changed, nothing is done
+ */
+void tui_render(tui_t* tui)
+{
+  if (!tui_is_damaged(tui)) return;
+
+  tui_profile_frame_t* frame = &tui->profile.frame;
+
+  long start = tui_profile_time_get(tui);
+
+  long time = start;
+
+  trace_begin("frame", NULL);
+
+  curs_set(0);
+
+  tui_menu_t* menu = tui->menu;
+
+  // 1. Update windows that have changed
+  trace_begin("update", NULL);
+
+  if (tui->_is_dirty)
+  {
+    tui_update(tui);
+  }
+  else
+  {
+    tui_windows_damage_update(tui->windows, tui->window_count);
+
+    if (menu)
+    {
+      tui_windows_damage_update(menu->windows, menu->window_count);
+    }
+  }
+
+  tui_profile_stage_end(tui, &frame->update, &time);
+
+  trace_end("update", NULL);
+
+  // 2. Calculate layout and find windows that have moved
+  trace_begin("layout", NULL);
+
+  tui_resize(tui);
+
+  // Windows that have moved might change the layout in their resize event
+  for (int pass = 0; pass < TUI_LAYOUT_PASS_COUNT && tui_rect_damage_calc(tui); pass++)
+  {
+    tui_resize(tui);
+  }
+
+  if (tui->_cells_size.w != tui->size.w || tui->_cells_size.h != tui->size.h)
+  {
+    if (tui_cells_resize(tui) != 0)
+    {
+      error_print("tui_cells_resize");
+
+      trace_end("layout", NULL);
+
+      trace_end("frame", NULL);
+
+      return;
+    }
+
+    tui->_is_dirty = true;
+  }
+
+  if (tui_windows_damage_escalate(tui->windows, tui->window_count) ||
+      (menu && tui_windows_damage_escalate(menu->windows, menu->window_count)))
+  {
+    tui->_is_dirty = true;
+  }
+
+  tui_profile_stage_end(tui, &frame->resize, &time);
+
+  trace_end("layout", NULL);
+
+  // 3. Render every window or just the damaged windows
+  trace_begin("render", NULL);
+
+  if (tui->_is_dirty)
+  {
+    tui_full_render(tui);
+  }
+  else
+  {
+    // The cursor is set again if it's window is rendered
+    if (tui->window && tui_window_is_redrawn(tui->window))
+    {
+      tui->cursor.is_active = false;
+    }
+
+    tui_windows_damage_render(tui->windows, tui->window_count);
+
+    if (menu)
+    {
+      tui_windows_damage_render(menu->windows, menu->window_count);
+    }
+  }
+
+  bool is_all = tui->_is_dirty;
+
+  tui_windows_clean(tui->windows, tui->window_count, is_all);
+
+  if (menu)
+  {
+    tui_windows_clean(menu->windows, menu->window_count, is_all);
+  }
+
+  tui->_is_dirty = false;
+
+  if (tui->profile.is_active)
+  {
+    tui_profile_draw(tui);
+  }
+
+  tui_profile_stage_end(tui, &frame->render, &time);
+
+  trace_end("render", NULL);
+
+  // 4. Flush the changed cells to the terminal
+  trace_begin("flush", NULL);
+
+  tui_cells_flush(tui);
+
+  tui_profile_stage_end(tui, &frame->flush, &time);
+
+  trace_end("flush", NULL);
+
+  frame->total = time - start;
+
+  tui_profile_frame_end(tui);
+
+  trace_end("frame", NULL);
+
+  tui_cursor_t cursor = tui->cursor;
+
+  if (cursor.is_active)
+  {
+    if (cursor.y >= 0 && cursor.y < tui->size.h &&
+        cursor.x >= 0 && cursor.x < tui->size.w)
+    {
+      move(cursor.y, cursor.x);
+
+      curs_set(1);
+    }
+  }
+}
+
+/*
+ * Toggle profiling of frames, showing the overlay
+ *
+ * The CSV file is opened the first time, and new frames are appended
+ */
+void tui_profile_toggle(tui_t* tui)
+{
+  tui_profile_t* profile = &tui->profile;
+
+  profile->is_active = !profile->is_active;
+
+  if (profile->is_active && !profile->file && profile->file_path)
+  {
+    profile->file = fopen(profile->file_path, "a");
+
+    if (!profile->file)
+    {
+      error_print("Failed to open profile file: %s", profile->file_path);
+    }
+    else if (fseek(profile->file, 0, SEEK_END) == 0 && ftell(profile->file) == 0)
+    {
+      fprintf(profile->file, "frame,update,resize,render,flush,total,window,window_time\n");
+    }
+  }
+
+  if (profile->is_active)
+  {
+    memset(&profile->frame, 0, sizeof(tui_profile_frame_t));
+  }
+  else if (profile->file)
+  {
+    fflush(profile->file);
+  }
+
+  // The overlay is drawn over, or removed from, every window
+  tui_dirty_set(tui);
+}
+
+/*
+ * Configuration struct for parent window
+ */
+typedef struct tui_window_parent_config_t
+{
+  char*              name;
+  tui_window_event_t event;
+  tui_rect_t         rect;
+  bool               w_grow;
+  bool               h_grow;
+  tui_color_t        color;
   bool               is_hidden;
   bool               is_atomic;
   bool               is_interact;
@@ -2324,29 +3541,36 @@ static inline tui_window_parent_t* _tui_window_parent_create(tui_t* tui, tui_win
 
 /*
  * Set string of text window to copy of specified string
+ *
+ * If the string hasn't changed, the window is left as it is
  */
 void tui_window_text_string_set(tui_window_text_t* window, char* string)
 {
-  if (window && string)
-  {
-    size_t length = strlen(string);
+  if (!window || !string) return;
 
-    if (length >= window->string_size)
-    {
-      free(window->string);
+  // The same text doesn't have to be measured or rendered again
+  if (window->string && strcmp(window->string, string) == 0) return;
 
-      window->string = malloc(sizeof(char) * (length + 1));
+  size_t length = strlen(string);
 
-      window->string_size = length + 1;
-    }
-    
-    if (window->string)
-    {
-      strcpy(window->string, string);
+  // The buffer is reused, and only grows when the string is longer
+  if (length >= window->string_size)
+  {
+    char* temp_string = realloc(window->string, sizeof(char) * (length + 1));
 
-      window->string[length] = '\0';
-    }
+    if (!temp_string) return;
+
+    window->string = temp_string;
+
+    window->string_size = length + 1;
   }
+
+  memcpy(window->string, string, sizeof(char) * (length + 1));
+
+  // New text might have another size
+  tui_window_layout_dirty_set((tui_window_t*) window);
+
+  tui_window_dirty_set((tui_window_t*) window);
 }
 
 /*
@@ -2438,7 +3662,33 @@ typedef struct tui_window_grid_config_t
 } tui_window_grid_config_t;
 
 /*
- * Resize grid and store size in _size
+ * Clear the squares of grid
+ */
+void tui_window_grid_clear(tui_window_grid_t* window)
+{
+  if (!window->grid) return;
+
+  memset(window->grid, 0, sizeof(tui_window_grid_square_t) * window->_size.w * window->_size.h);
+
+  tui_window_dirty_set((tui_window_t*) window);
+}
+
+/*
+ * Clear the squares of layer, showing grid as it is
+ */
+void tui_window_grid_layer_clear(tui_window_grid_t* window)
+{
+  if (!window->layer) return;
+
+  memset(window->layer, 0, sizeof(tui_window_grid_square_t) * window->_size.w * window->_size.h);
+
+  tui_window_dirty_set((tui_window_t*) window);
+}
+
+/*
+ * Resize grid, store size in _size and clear it and it's layer
+ *
+ * The buffers are only reallocated if the grid grows
  */
 int tui_window_grid_resize(tui_window_grid_t* window, tui_size_t size)
 {
@@ -2447,22 +3697,57 @@ int tui_window_grid_resize(tui_window_grid_t* window, tui_size_t size)
     return 1;
   }
 
-  free(window->grid);
+  size_t square_count = size.w * size.h;
+
+  if (square_count > window->_capacity)
+  {
+    tui_window_grid_square_t* grid = realloc(window->grid, sizeof(tui_window_grid_square_t) * square_count);
+
+    if (!grid)
+    {
+      return 2;
+    }
+
+    // A grid without squares has no size
+    if (!window->grid)
+    {
+      tui_window_layout_dirty_set((tui_window_t*) window);
+    }
 
-  int square_count = size.w * size.h;
+    window->grid = grid;
 
-  tui_window_grid_square_t* grid = malloc(sizeof(tui_window_grid_square_t) * square_count);
+    tui_window_grid_square_t* _grid = realloc(window->_grid, sizeof(tui_window_grid_square_t) * square_count);
 
-  if (!grid)
+    if (!_grid)
+    {
+      return 3;
+    }
+
+    window->_grid = _grid;
+
+    tui_window_grid_square_t* layer = realloc(window->layer, sizeof(tui_window_grid_square_t) * square_count);
+
+    if (!layer)
+    {
+      return 4;
+    }
+
+    window->layer = layer;
+
+    window->_capacity = square_count;
+  }
+
+  // The last render no longer matches the grid
+  if (size.w != window->_size.w || size.h != window->_size.h)
   {
-    return 2;
+    window->_grid_rect = TUI_RECT_NONE;
   }
 
-  memset(grid, 0, sizeof(tui_window_grid_square_t) * square_count);
+  window->_size = size;
 
-  window->grid = grid;
+  tui_window_grid_clear(window);
 
-  window->_size = size;
+  tui_window_grid_layer_clear(window);
 
   return 0;
 }
@@ -2507,6 +3792,12 @@ static inline tui_window_grid_t* _tui_window_grid_create(tui_t* tui, tui_window_
 
   if (tui_window_grid_resize(window, config.size) != 0)
   {
+    free(window->grid);
+
+    free(window->_grid);
+
+    free(window->layer);
+
     free(window);
 
     return NULL;
@@ -2533,6 +3824,9 @@ static inline int tui_windows_window_append(tui_window_t*** windows, size_t* cou
 
   (*count)++;
 
+  // Searches might find this window instead
+  window->tui->_generation++;
+
   return 0;
 }
 
@@ -2541,6 +3835,8 @@ static inline int tui_windows_window_append(tui_window_t*** windows, size_t* cou
  */
 static inline int tui_window_append(tui_t* tui, tui_window_t* window)
 {
+  tui_window_layout_dirty_set(window);
+
   return tui_windows_window_append(&tui->windows, &tui->window_count, window);
 }
 
@@ -2551,6 +3847,8 @@ static inline int tui_menu_window_append(tui_menu_t* menu, tui_window_t* window)
 {
   window->menu = menu;
 
+  tui_window_layout_dirty_set(window);
+
   return tui_windows_window_append(&menu->windows, &menu->window_count, window);
 }
 
@@ -2562,6 +3860,8 @@ static inline int tui_parent_child_append(tui_window_parent_t* parent, tui_windo
   child->parent = parent;
   child->menu   = parent->head.menu;
 
+  tui_window_layout_dirty_set(child);
+
   return tui_windows_window_append(&parent->children, &parent->child_count, child);
 }
 
@@ -2831,35 +4131,83 @@ void tui_window_grid_square_set(tui_window_grid_t* window, int x, int y, tui_win
 {
   tui_window_grid_square_t* old_square = tui_window_grid_square_get(window, x, y);
 
-  if (old_square)
-  {
-    *old_square = square;
+  if (old_square)
+  {
+    *old_square = square;
+
+    tui_window_dirty_set((tui_window_t*) window);
+  }
+}
+
+/*
+ * Modify grid square by changing symbol or color if specified
+ */
+void tui_window_grid_square_modify(tui_window_grid_t* window, int x, int y, tui_window_grid_square_t square)
+{
+  tui_window_grid_square_t* old_square = tui_window_grid_square_get(window, x, y);
+
+  if (old_square)
+  {
+    tui_grid_square_modify(old_square, square);
+
+    tui_window_dirty_set((tui_window_t*) window);
+  }
+}
+
+/*
+ * Braille dots of the sub-pixels of a square, 2 dots wide and 4 dots high
+ */
+static const wchar_t TUI_GRID_DOTS[4][2] =
+{
+  { 0x01, 0x08 },
+  { 0x02, 0x10 },
+  { 0x04, 0x20 },
+  { 0x40, 0x80 }
+};
+
+#define TUI_GRID_DOT_EMPTY 0x2800
+
+/*
+ * Set dot at x y in grid window, where each square has 2x4 dots
+ *
+ * The dots of a square are kept in it's braille symbol,
+ * and all dots of a square get the same color
+ */
+void tui_window_grid_dot_set(tui_window_grid_t* window, int x, int y, short color)
+{
+  if (x < 0 || y < 0) return;
+
+  tui_window_grid_square_t* square = tui_window_grid_square_get(window, x / 2, y / 4);
+
+  if (square)
+  {
+    wchar_t dots = TUI_GRID_DOT_EMPTY;
+
+    if (square->symbol >= TUI_GRID_DOT_EMPTY && square->symbol <= TUI_GRID_DOT_EMPTY + 0xff)
+    {
+      dots = square->symbol;
+    }
+
+    square->symbol = dots | TUI_GRID_DOTS[y % 4][x % 2];
+
+    square->color.fg = color;
+
+    tui_window_dirty_set((tui_window_t*) window);
   }
 }
 
 /*
- * Modify grid square by changing symbol or color if specified
+ * Modify square of layer, which is drawn over the square of grid
  */
-void tui_window_grid_square_modify(tui_window_grid_t* window, int x, int y, tui_window_grid_square_t square)
+void tui_window_grid_layer_modify(tui_window_grid_t* window, int x, int y, tui_window_grid_square_t square)
 {
-  tui_window_grid_square_t* old_square = tui_window_grid_square_get(window, x, y);
-
-  if (old_square)
+  if (window->layer &&
+      x >= 0 && x < window->_size.w &&
+      y >= 0 && y < window->_size.h)
   {
-    if (square.color.fg != TUI_COLOR_NONE)
-    {
-      old_square->color.fg = square.color.fg;
-    }
-
-    if (square.color.bg != TUI_COLOR_NONE)
-    {
-      old_square->color.bg = square.color.bg;
-    }
+    tui_grid_square_modify(&window->layer[y * window->_size.w + x], square);
 
-    if (square.symbol)
-    {
-      old_square->symbol = square.symbol;
-    }
+    tui_window_dirty_set((tui_window_t*) window);
   }
 }
 
@@ -3136,13 +4484,189 @@ int tui_list_item_add(tui_list_t* list, tui_window_t* item)
   return 0;
 }
 
+/*
+ * Bind the items of virtual list to the rows from row_offset
+ *
+ * Items past the last row, or past the items that fill the list, are hidden.
+ * The rows that are no longer bound to any item are released first
+ */
+static inline void tui_list_rows_bind(tui_list_t* list)
+{
+  size_t offset = list->row_offset;
+
+  size_t count = (offset < list->row_count) ? MIN(list->pool_count, list->row_count - offset) : 0;
+
+  count = MIN(count, list->item_count);
+
+  if (list->row_release)
+  {
+    for (size_t index = 0; index < list->_bind_count; index++)
+    {
+      size_t row = list->_bind_offset + index;
+
+      if (row < offset || row >= offset + count)
+      {
+        list->row_release(list, list->items[index], row);
+      }
+    }
+  }
+
+  list->_bind_offset = offset;
+  list->_bind_count  = count;
+
+  for (size_t index = 0; index < list->item_count; index++)
+  {
+    tui_window_t* item = list->items[index];
+
+    size_t row = offset + index;
+
+    bool is_hidden = (index >= count);
+
+    if (item->is_hidden != is_hidden)
+    {
+      item->is_hidden = is_hidden;
+
+      tui_window_layout_dirty_set(item);
+    }
+
+    if (!is_hidden)
+    {
+      list->row_render(list, item, row);
+    }
+
+    tui_window_dirty_set(item);
+  }
+}
+
+/*
+ * Get the number of items that fill the list, one more than fits
+ *
+ * Before the first layout, the size of the list is not known yet,
+ * so the screen and the preliminary size of the first item are used
+ */
+static inline size_t tui_list_pool_count_get(tui_list_t* list)
+{
+  if (list->item_count == 0) return 1;
+
+  tui_window_t* item = list->items[0];
+
+  tui_window_t* parent = (tui_window_t*) item->parent;
+
+  int list_size = list->is_vertical ? getmaxy(stdscr) : getmaxx(stdscr);
+
+  if (parent && parent->_rect.w > 0 && parent->_rect.h > 0)
+  {
+    list_size = list->is_vertical ? parent->_rect.h : parent->_rect.w;
+  }
+
+  if (item->_rect.w <= 0 || item->_rect.h <= 0)
+  {
+    tui_window_size_calc(item);
+  }
+
+  int item_size = list->is_vertical ? item->_rect.h : item->_rect.w;
+
+  if (item_size <= 0 || list_size <= 0) return MAX(1, list->pool_count);
+
+  return list_size / item_size + 1;
+}
+
+/*
+ * Grow the pool of virtual list, so that it can fill the list
+ *
+ * The pool is sized by the items that fit in the list, not by the rows,
+ * and items that are left over after the list has shrunk are kept hidden
+ */
+static inline int tui_list_pool_grow(tui_list_t* list)
+{
+  list->pool_count = MIN(list->row_count, tui_list_pool_count_get(list));
+
+  while (list->item_count < list->pool_count)
+  {
+    tui_window_t* item = list->item_create(list);
+
+    if (!item)
+    {
+      return 1;
+    }
+
+    if (tui_list_item_add(list, item) != 0)
+    {
+      return 2;
+    }
+  }
+
+  return 0;
+}
+
+/*
+ * Get the row of the selected item
+ */
+size_t tui_list_row_get(tui_list_t* list)
+{
+  return list->row_offset + list->item_index;
+}
+
+/*
+ * Check if row of virtual list is bound to an item, and therefor on screen
+ */
+bool tui_list_row_is_bound(tui_list_t* list, size_t row)
+{
+  return row >= list->_bind_offset && row < list->_bind_offset + list->_bind_count;
+}
+
+/*
+ * Set the number of rows of virtual list, and bind the items again
+ */
+int tui_list_row_count_set(tui_list_t* list, size_t count)
+{
+  list->row_count = count;
+
+  if (list->row_offset + list->item_index >= count)
+  {
+    list->row_offset = 0;
+    list->item_index = 0;
+  }
+
+  if (tui_list_pool_grow(list) != 0)
+  {
+    return 1;
+  }
+
+  tui_list_rows_bind(list);
+
+  return 0;
+}
+
 /*
  * Update list item by changing to another if it is invisable
  *
+ * The pool of virtual list is resized, in case the list has changed size
+ *
  * RETURN (bool changed)
  */
 bool tui_list_item_update(tui_list_t* list)
 {
+  if (list->row_render)
+  {
+    size_t count = list->pool_count;
+
+    if (tui_list_pool_grow(list) != 0)
+    {
+      error_print("tui_list_pool_grow");
+    }
+
+    if (list->pool_count != count)
+    {
+      tui_list_rows_bind(list);
+    }
+  }
+
+  if (list->item_count == 0)
+  {
+    return false;
+  }
+
   tui_window_t* item = list->items[list->item_index];
 
   if (!item->_is_visable)
@@ -3212,6 +4736,51 @@ void tui_list_delete(tui_list_t** list)
   *list = NULL;
 }
 
+/*
+ * Configuration struct for virtual list
+ */
+typedef struct tui_list_virtual_config_t
+{
+  bool                   is_vertical;
+  size_t                 row_count;
+  tui_list_item_create_t item_create;
+  tui_list_row_render_t  row_render;
+  tui_list_row_release_t row_release;
+  void*                  data;
+} tui_list_virtual_config_t;
+
+/*
+ * Create virtual list struct, with a pool of items bound to it's rows
+ */
+tui_list_t* tui_list_virtual_create(tui_t* tui, tui_list_virtual_config_t config)
+{
+  if (!config.item_create || !config.row_render)
+  {
+    return NULL;
+  }
+
+  tui_list_t* list = tui_list_create(tui, config.is_vertical);
+
+  if (!list)
+  {
+    return NULL;
+  }
+
+  list->item_create = config.item_create;
+  list->row_render  = config.row_render;
+  list->row_release = config.row_release;
+  list->data        = config.data;
+
+  if (tui_list_row_count_set(list, config.row_count) != 0)
+  {
+    tui_list_delete(&list);
+
+    return NULL;
+  }
+
+  return list;
+}
+
 /*
  * Scroll forward to next selected item
  */
@@ -3229,6 +4798,16 @@ static inline bool tui_list_scroll_forward(tui_list_t* list)
     }
   }
 
+  // A virtual list scrolls it's rows past the last visable item
+  if (list->row_render && tui_list_row_get(list) + 1 < list->row_count)
+  {
+    list->row_offset++;
+
+    tui_list_rows_bind(list);
+
+    return true;
+  }
+
   return false;
 }
 
@@ -3249,6 +4828,16 @@ static inline bool tui_list_scroll_backward(tui_list_t* list)
     }
   }
 
+  // A virtual list scrolls it's rows before the first item
+  if (list->row_render && list->row_offset > 0)
+  {
+    list->row_offset--;
+
+    tui_list_rows_bind(list);
+
+    return true;
+  }
+
   return false;
 }
 
@@ -3304,6 +4893,11 @@ void tui_window_set(tui_t* tui, tui_window_t* window)
 
     tui->window = window;
 
+    // Both windows might look different when focus has changed
+    tui_window_dirty_set(last_window);
+
+    tui_window_dirty_set(window);
+
     if (last_window && last_window->event.exit)
     {
       last_window->event.exit(last_window);
@@ -3314,9 +4908,11 @@ void tui_window_set(tui_t* tui, tui_window_t* window)
       window->event.enter(window);
     }
 
-    if (window->menu)
+    if (window->menu && tui->menu != window->menu)
     {
       tui->menu = window->menu;
+
+      tui_dirty_set(tui);
     }
   }
 }
@@ -3339,6 +4935,8 @@ void tui_menu_set(tui_t* tui, tui_menu_t* menu)
 
   tui->menu = menu;
 
+  tui_dirty_set(tui);
+
   // If the active window is from another menu,
   // choose a window in menu to set active
   if (!tui->window ||
@@ -3423,8 +5021,89 @@ void tui_stop(tui_t* tui)
   tui->is_running = false;
 }
 
+/*
+ * Get monotonic time in milliseconds
+ */
+static inline long tui_time_get(void)
+{
+  struct timespec time;
+
+  clock_gettime(CLOCK_MONOTONIC, &time);
+
+  return (time.tv_sec * 1000) + (time.tv_nsec / 1000000);
+}
+
+/*
+ * Get milliseconds until the next render is allowed
+ */
+static inline int tui_frame_wait_get(tui_t* tui)
+{
+  if (tui->fps <= 0) return 0;
+
+  long elapsed = tui_time_get() - tui->_render_time;
+
+  return MAX(0, (1000 / tui->fps) - elapsed);
+}
+
+/*
+ * Get milliseconds to wait for a key
+ *
+ * A pending render or a tick event limits the wait, otherwise wait forever
+ */
+static inline int tui_key_wait_get(tui_t* tui)
+{
+  int wait = -1;
+
+  if (tui->event.tick)
+  {
+    wait = MAX(0, tui->delay);
+  }
+
+  if (tui_is_damaged(tui))
+  {
+    int frame_wait = tui_frame_wait_get(tui);
+
+    wait = (wait < 0) ? frame_wait : MIN(wait, frame_wait);
+  }
+
+  return wait;
+}
+
+/*
+ * Handle key in main loop
+ */
+static inline void tui_key_handle(tui_t* tui, int key)
+{
+  if (key == KEY_CTRLC)
+  {
+    tui->is_running = false;
+
+    return;
+  }
+
+  // The key is traced, to line up input with frames and fetches
+  trace_begin("key", keyname(key));
+
+  if (key == KEY_RESIZE)
+  {
+    tui_resize(tui);
+
+    tui_dirty_set(tui);
+  }
+
+  tui_event(tui, key);
+
+  trace_end("key", NULL);
+}
+
 /*
  * Start tui - main loop
+ *
+ * Every pending key is handled before the tui is rendered, so held keys
+ * and resizes don't queue up frames, and with fps the tui is rendered
+ * at most fps times per second
+ *
+ * If tui has a tick event, wait at most delay milliseconds for a key
  */
 void tui_start(tui_t* tui)
 {
@@ -3432,25 +5111,37 @@ void tui_start(tui_t* tui)
 
   tui_render(tui);
 
-  int key;
+  tui->_render_time = tui_time_get();
 
-  while (tui->is_running && (key = wgetch(stdscr)))
+  while (tui->is_running)
   {
-    if (key == KEY_CTRLC)
+    wtimeout(stdscr, tui_key_wait_get(tui));
+
+    int key = wgetch(stdscr);
+
+    // Drain the keys that are already pending, without waiting
+    while (key != ERR && tui->is_running)
     {
-      tui->is_running = false;
+      tui_key_handle(tui, key);
 
-      break;
+      wtimeout(stdscr, 0);
+
+      key = wgetch(stdscr);
     }
 
-    if (key == KEY_RESIZE)
+    if (!tui->is_running) break;
+
+    if (tui->event.tick)
     {
-      tui_resize(tui);
+      tui->event.tick(tui);
     }
 
-    tui_event(tui, key);
+    if (tui_is_damaged(tui) && tui_frame_wait_get(tui) == 0)
+    {
+      tui_render(tui);
 
-    tui_render(tui);
+      tui->_render_time = tui_time_get();
+    }
   }
 }
 
@@ -3700,7 +5391,7 @@ bool tui_tab_backward(tui_t* tui)
   return false;
 }
 
-tui_window_t* tui_window_window_search(tui_window_t* window, char* search);
+static inline tui_window_t* _tui_window_window_search(tui_window_t* window, char* search);
 
 /*
  * Search for window in array of windows and children
@@ -3721,7 +5412,7 @@ tui_window_t* tui_windows_window_search(tui_window_t** windows, size_t count, ch
     {
       if (!rest) return window;
 
-      return tui_window_window_search(window, rest + 1);
+      return _tui_window_window_search(window, rest + 1);
     }
   }
 
@@ -3763,9 +5454,9 @@ tui_window_t* tui_menu_window_search(tui_menu_t* menu, char* search)
 }
 
 /*
- * Search window from base window
+ * Just search window from base window, walking the windows
  */
-tui_window_t* tui_window_window_search(tui_window_t* window, char* search)
+static inline tui_window_t* _tui_window_window_search(tui_window_t* window, char* search)
 {
   // Base case, if not window or not search
   if (!window || !search || strlen(search) == 0)
@@ -3785,7 +5476,7 @@ tui_window_t* tui_window_window_search(tui_window_t* window, char* search)
     }
     else if (window->parent)
     {
-      return tui_window_window_search((tui_window_t*) window->parent, rest + 1);
+      return _tui_window_window_search((tui_window_t*) window->parent, rest + 1);
     }
     else if (window->menu)
     {
@@ -3804,6 +5495,71 @@ tui_window_t* tui_window_window_search(tui_window_t* window, char* search)
   return NULL;
 }
 
+/*
+ * Hash search string (FNV-1a)
+ */
+static inline uint64_t tui_search_hash(const char* search)
+{
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (; *search; search++)
+  {
+    hash ^= (unsigned char) *search;
+
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+}
+
+/*
+ * Search window from base window
+ *
+ * The result is cached in the base window, until windows are added or removed
+ */
+tui_window_t* tui_window_window_search(tui_window_t* window, char* search)
+{
+  if (!window || !search || strlen(search) == 0)
+  {
+    return window;
+  }
+
+  size_t generation = window->tui->_generation;
+
+  uint64_t hash = tui_search_hash(search);
+
+  tui_search_t* cache = &window->_searches[hash % TUI_SEARCH_CACHE_SIZE];
+
+  if (cache->search && cache->generation == generation &&
+      cache->hash == hash && strcmp(cache->search, search) == 0)
+  {
+    return cache->window;
+  }
+
+  tui_window_t* result = _tui_window_window_search(window, search);
+
+  // Replace the cached search, if it isn't the same search
+  if (!cache->search || cache->hash != hash || strcmp(cache->search, search) != 0)
+  {
+    char* search_copy = strdup(search);
+
+    if (!search_copy)
+    {
+      return result;
+    }
+
+    free(cache->search);
+
+    cache->search = search_copy;
+  }
+
+  cache->hash       = hash;
+  cache->window     = result;
+  cache->generation = generation;
+
+  return result;
+}
+
 /*
  * Search for text window from base window
  */